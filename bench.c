@@ -0,0 +1,499 @@
+/* twxbench: draws standard workloads on a headless terminal and prints one
+ * JSON object per scenario on stdout.
+ * Usage: twxbench [scenario...] (all scenarios if none is given) */
+#if _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlx.h>
+#include <hbs.h>
+#include <acx1.h>
+#include <twx.h>
+
+#define BENCH_HEIGHT 50
+#define BENCH_WIDTH 160
+#define BENCH_STEP_MAX 10000 // latencies kept per scenario
+#define BENCH_WIN_MAX 4
+#define BENCH_WAIT_US 10000000 // a step without a frame by then fails
+
+#define CONTENT_SIZE 0x100000 // bytes of each set_content() text
+#define CONTENT_STEPS 40
+#define TAIL_LINES 10000
+#define TYPING_LINE 100000 // bytes on the line before typing starts
+#define TYPING_KEYS 2000
+#define TYPING_PERIOD_US 1000 // 1000 keys per second
+#define RESIZE_STEPS 300
+#define FILL_STEPS 500
+
+typedef struct bench_s bench_t;
+typedef struct scenario_s scenario_t;
+
+struct bench_s
+{
+    twx_t * twx;
+    twx_backend_t * be;
+    twx_win_t * win_a[BENCH_WIN_MAX]; // destroyed when the scenario ends
+    unsigned int win_n;
+    zlx_tid_t tid;
+    uint8_t running;
+    twx_headless_stats_t start;
+    twx_stats_t twx_start;
+    uint64_t t0; // when the current step started
+    uint64_t frames; // frames when the current step started
+    uint64_t input_bytes; // content, text or keys fed to the windows
+    uint32_t seed;
+    unsigned int n;
+    uint32_t lat[BENCH_STEP_MAX];
+};
+
+struct scenario_s
+{
+    char const * name;
+    int (* run) (bench_t * b);
+};
+
+static acx1_attr_t attrs[3] = { { 0, 7, 0 }, { 0, 11, 1 }, { 4, 15, 0 } };
+
+/* now_us *******************************************************************/
+static uint64_t now_us (void)
+{
+#if _WIN32
+    LARGE_INTEGER c, f;
+    QueryPerformanceCounter(&c);
+    QueryPerformanceFrequency(&f);
+    return (uint64_t) c.QuadPart * 1000000 / (uint64_t) f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+#endif
+}
+
+/* sleep_until **************************************************************/
+static void sleep_until (uint64_t t)
+{
+    uint64_t n = now_us();
+    if (n >= t) return;
+#if _WIN32
+    Sleep((DWORD) ((t - n) / 1000));
+#else
+    {
+        struct timespec ts;
+        ts.tv_sec = (time_t) ((t - n) / 1000000);
+        ts.tv_nsec = (long) ((t - n) % 1000000 * 1000);
+        nanosleep(&ts, NULL);
+    }
+#endif
+}
+
+/* rnd **********************************************************************/
+/**
+ *  xorshift32; every scenario starts from the same seed so the workloads
+ *  are the same from one run to the next.
+ */
+static uint32_t rnd (bench_t * b)
+{
+    b->seed ^= b->seed << 13;
+    b->seed ^= b->seed >> 17;
+    b->seed ^= b->seed << 5;
+    return b->seed;
+}
+
+/* gen_line *****************************************************************/
+/**
+ *  Writes a line of hypertext about width columns wide mixing attributes,
+ *  ASCII and wide chars; returns its length (without the new line).
+ */
+static size_t gen_line (bench_t * b, char * p, size_t i)
+{
+    size_t n;
+    n = sprintf(p, "%08lu \a%c%s\a%c", (unsigned long) i, 1 + (int) (i & 1),
+                (rnd(b) & 7) ? "info" : "\xe8\xad\xa6\xe5\x91\x8a", 0);
+    while (n < BENCH_WIDTH - 8)
+    {
+        p[n++] = ' ';
+        if (!(rnd(b) & 15)) { memcpy(p + n, "\xc3\xa9t\xc3\xa9", 5); n += 5; }
+        else n += sprintf(p + n, "word%u", (unsigned int) (rnd(b) % 1000));
+    }
+    return n;
+}
+
+/* run_ui *******************************************************************/
+static uint8_t ZLX_CALL run_ui (void * arg)
+{
+    bench_t * b = arg;
+    return (uint8_t) twx_run(b->twx);
+}
+
+/* bench_init ***************************************************************/
+static int bench_init (bench_t * b)
+{
+    memset(b, 0, sizeof(*b));
+    b->seed = 0x12345678;
+    if (twx_headless_create(&b->be, BENCH_HEIGHT, BENCH_WIDTH)) return 1;
+    if (twx_create_on(&b->twx, b->be))
+    {
+        twx_headless_destroy(b->be);
+        return 1;
+    }
+    twx_set_frame_interval(b->twx, 0);
+    return 0;
+}
+
+/* keep *********************************************************************/
+/**
+ *  Adds a freshly created window to the ones destroyed by bench_finish().
+ */
+static int keep (bench_t * b, twx_status_t ts, twx_win_t * * win_ptr)
+{
+    if (ts) return 1;
+    b->win_a[b->win_n++] = *win_ptr;
+    return 0;
+}
+
+/* bench_start **************************************************************/
+/**
+ *  Starts the UI thread on the root window and waits for the first frame.
+ */
+static int bench_start (bench_t * b, twx_win_t * root)
+{
+    twx_set_root(root);
+    if (hbs_thread_create(&b->tid, run_ui, b)) return 1;
+    b->running = 1;
+    if (twx_headless_wait(b->be, 1, BENCH_WAIT_US) < 1)
+    {
+        fprintf(stderr, "no first frame\n");
+        return 1;
+    }
+    twx_headless_stats(b->be, &b->start, NULL);
+    twx_stats(b->twx, &b->twx_start);
+    return 0;
+}
+
+/* step_begin ***************************************************************/
+static void step_begin (bench_t * b)
+{
+    twx_headless_stats_t t;
+    twx_headless_stats(b->be, &t, NULL);
+    b->frames = t.frames;
+    b->t0 = now_us();
+}
+
+/* step_end *****************************************************************/
+/**
+ *  Waits for the frame showing the change made in the step; fails if it
+ *  does not come in time, as when twx_run() stopped.
+ */
+static int step_end (bench_t * b)
+{
+    if (twx_headless_wait(b->be, b->frames + 1, BENCH_WAIT_US) <= b->frames)
+    {
+        fprintf(stderr, "no frame after step %u\n", b->n);
+        return 1;
+    }
+    if (b->n < BENCH_STEP_MAX) b->lat[b->n++] = (uint32_t) (now_us() - b->t0);
+    return 0;
+}
+
+/* cmp_u32 ******************************************************************/
+static int cmp_u32 (void const * a, void const * b)
+{
+    uint32_t x = *(uint32_t const *) a, y = *(uint32_t const *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* report *******************************************************************/
+static void report (bench_t * b, char const * name, uint64_t us)
+{
+    twx_headless_stats_t t;
+    twx_stats_t ts;
+    uint64_t sum = 0, frames, hns = 0;
+    unsigned int i;
+    double s = us ? us / 1e6 : 1e-6;
+
+    twx_headless_stats(b->be, &t, NULL);
+    twx_stats(b->twx, &ts);
+    for (i = 0; i < ts.class_n; ++i) hns += ts.class_a[i].handler_ns;
+    for (i = 0; i < b->twx_start.class_n; ++i)
+        hns -= b->twx_start.class_a[i].handler_ns;
+    frames = t.frames - b->start.frames;
+    if (!frames) frames = 1;
+    for (i = 0; i < b->n; ++i) sum += b->lat[i];
+    qsort(b->lat, b->n, sizeof(uint32_t), cmp_u32);
+#define PCT(_p) (b->n ? b->lat[(b->n - 1) * (_p) / 100] : 0)
+    printf("{\"scenario\":\"%s\",\"steps\":%u,\"elapsed_us\":%lu,"
+           "\"steps_per_s\":%.1f,\"input_bytes_per_s\":%.0f,"
+           "\"latency_us\":{\"min\":%u,\"p50\":%u,\"p90\":%u,\"p99\":%u,"
+           "\"max\":%u,\"mean\":%.1f},"
+           "\"frames\":%lu,\"out_bytes_per_frame\":%.1f,"
+           "\"escapes_per_frame\":%.1f,\"cursor_moves_per_frame\":%.1f,"
+           "\"writes_per_frame\":%.2f,\"draws_per_frame\":%.1f,"
+           "\"draws_skipped_per_frame\":%.1f,\"handler_us_per_frame\":%.1f}\n",
+           name, b->n, (unsigned long) us, b->n / s, b->input_bytes / s,
+           PCT(0), PCT(50), PCT(90), PCT(99), PCT(100),
+           b->n ? (double) sum / b->n : 0.0,
+           (unsigned long) frames,
+           (double) (t.bytes - b->start.bytes) / frames,
+           (double) (t.escapes - b->start.escapes) / frames,
+           (double) (t.cursor_moves - b->start.cursor_moves) / frames,
+           (double) (t.writes - b->start.writes) / frames,
+           (double) (ts.draws - b->twx_start.draws) / frames,
+           (double) (ts.draws_skipped - b->twx_start.draws_skipped) / frames,
+           hns / 1e3 / frames);
+#undef PCT
+    fflush(stdout);
+}
+
+/* bench_finish *************************************************************/
+static void bench_finish (bench_t * b)
+{
+    if (b->running)
+    {
+        twx_shutdown(b->twx, TWX_OK);
+        hbs_thread_join(b->tid, NULL);
+    }
+    while (b->win_n) twx_win_destroy(b->win_a[--b->win_n]);
+    twx_destroy(b->twx);
+    twx_headless_destroy(b->be);
+}
+
+/* set_content **************************************************************/
+/**
+ *  Replaces the whole content of a full screen window with 1 MB of text
+ *  that differs on every row from the previous one, then refreshes it as
+ *  applications do.
+ */
+static int set_content (bench_t * b)
+{
+    twx_win_t * w;
+    char * t[2];
+    size_t n, i, k;
+    uint64_t t0;
+    int rc = 1;
+
+    t[0] = malloc(CONTENT_SIZE + BENCH_WIDTH * 2);
+    t[1] = malloc(CONTENT_SIZE + BENCH_WIDTH * 2);
+    do
+    {
+        if (!t[0] || !t[1]) break;
+        for (k = 0; k < 2; ++k)
+        {
+            for (n = i = 0; n < CONTENT_SIZE; ++i)
+            {
+                n += gen_line(b, t[k] + n, i);
+                t[k][n++] = '\n';
+            }
+            t[k][n] = 0;
+        }
+        if (keep(b, twx_htxt_win_create(b->twx, &w, attrs, 3, ""), &w)
+            || bench_start(b, w))
+            break;
+        t0 = now_us();
+        for (i = 0; i < CONTENT_STEPS; ++i)
+        {
+            step_begin(b);
+            if (twx_htxt_win_set_content(w, t[i & 1])) break;
+            twx_win_refresh(w);
+            if (step_end(b)) break;
+            b->input_bytes += CONTENT_SIZE;
+        }
+        if (i < CONTENT_STEPS) break;
+        report(b, "htxt_set_content_1m", now_us() - t0);
+        rc = 0;
+    }
+    while (0);
+    free(t[0]);
+    free(t[1]);
+    return rc;
+}
+
+/* log_tail *****************************************************************/
+/**
+ *  Appends lines one at a time to a window following the last row.
+ */
+static int log_tail (bench_t * b)
+{
+    twx_win_t * w;
+    char line[BENCH_WIDTH * 2];
+    size_t i, n;
+    uint64_t t0;
+
+    if (keep(b, twx_htxt_win_create(b->twx, &w, attrs, 3, ""), &w)
+        || bench_start(b, w))
+        return 1;
+    t0 = now_us();
+    for (i = 0; i < TAIL_LINES; ++i)
+    {
+        n = gen_line(b, line, i);
+        line[n++] = '\n';
+        line[n] = 0;
+        step_begin(b);
+        if (twx_htxt_win_append(w, line)) return 1;
+        if (step_end(b)) return 1;
+        b->input_bytes += n;
+    }
+    report(b, "htxt_log_tail_10k", now_us() - t0);
+    return 0;
+}
+
+/* typing *******************************************************************/
+/**
+ *  Types at a steady rate at the start of a long input line.
+ */
+static int typing (bench_t * b)
+{
+    twx_win_t * w;
+    acx1_event_t e;
+    char * line;
+    size_t i;
+    uint64_t t0;
+
+    line = malloc(TYPING_LINE + 1);
+    if (!line) return 1;
+    for (i = 0; i < TYPING_LINE; ++i) line[i] = 'a' + (char) (rnd(b) % 26);
+    line[i] = 0;
+    i = keep(b, twx_itxt_win_create(b->twx, &w, attrs, 3, "> ", line,
+                                    NULL, 0), &w);
+    free(line);
+    if (i) return 1;
+    twx_post_win_focus(w);
+    if (bench_start(b, w)) return 1;
+    e.type = ACX1_KEY;
+    e.km = ACX1_HOME;
+    step_begin(b);
+    if (twx_headless_push(b->be, &e)) return 1;
+    if (step_end(b)) return 1;
+    b->n = 0;
+    twx_headless_stats(b->be, &b->start, NULL);
+
+    t0 = now_us();
+    for (i = 0; i < TYPING_KEYS; ++i)
+    {
+        sleep_until(t0 + i * TYPING_PERIOD_US);
+        e.km = 'a' + (uint32_t) (i % 26);
+        step_begin(b);
+        if (twx_headless_push(b->be, &e)) return 1;
+        if (step_end(b)) return 1;
+        b->input_bytes += 1;
+    }
+    report(b, "itxt_typing_1k_per_s", now_us() - t0);
+    return 0;
+}
+
+/* resize_storm *************************************************************/
+/**
+ *  Resizes the terminal to random sizes under a split of a scrolled
+ *  hypertext window, a separator and an input line.
+ */
+static int resize_storm (bench_t * b)
+{
+    twx_win_t * sw;
+    twx_win_t * hw;
+    twx_win_t * bw;
+    twx_win_t * iw;
+    acx1_event_t e;
+    char * t;
+    size_t n, i;
+    uint64_t t0;
+
+    t = malloc(CONTENT_SIZE + BENCH_WIDTH * 2);
+    if (!t) return 1;
+    for (n = i = 0; n < CONTENT_SIZE; ++i)
+    {
+        n += gen_line(b, t + n, i);
+        t[n++] = '\n';
+    }
+    t[n] = 0;
+    i = keep(b, twx_split_win_create(b->twx, &sw, attrs, TWX_SPLIT_ROWS),
+             &sw)
+        || keep(b, twx_htxt_win_create(b->twx, &hw, attrs, 3, t), &hw)
+        || keep(b, twx_blank_win_create(b->twx, &bw, &attrs[2], '-'), &bw)
+        || keep(b, twx_itxt_win_create(b->twx, &iw, attrs, 3, "> ", "ls -l",
+                                       NULL, 0), &iw)
+        || twx_split_win_add(sw, hw, 0, 1)
+        || twx_split_win_add(sw, bw, 1, 0)
+        || twx_split_win_add(sw, iw, 1, 0);
+    free(t);
+    if (i) return 1;
+    twx_htxt_win_set_top(hw, 1000);
+    twx_post_win_focus(iw);
+    if (bench_start(b, sw)) return 1;
+
+    e.type = ACX1_RESIZE;
+    t0 = now_us();
+    for (i = 0; i < RESIZE_STEPS; ++i)
+    {
+        e.size.h = (uint16_t) (10 + rnd(b) % 71);
+        e.size.w = (uint16_t) (20 + rnd(b) % 221);
+        step_begin(b);
+        if (twx_headless_push(b->be, &e)) return 1;
+        if (step_end(b)) return 1;
+    }
+    report(b, "resize_storm", now_us() - t0);
+    return 0;
+}
+
+/* blank_fill ***************************************************************/
+/**
+ *  Repaints the whole screen by switching between two blank windows.
+ */
+static int blank_fill (bench_t * b)
+{
+    twx_win_t * w[2];
+    size_t i;
+    uint64_t t0;
+
+    if (keep(b, twx_blank_win_create(b->twx, &w[0], &attrs[0], '.'), w)
+        || keep(b, twx_blank_win_create(b->twx, &w[1], &attrs[2], '#'), w + 1)
+        || bench_start(b, w[0]))
+        return 1;
+    t0 = now_us();
+    for (i = 1; i <= FILL_STEPS; ++i)
+    {
+        step_begin(b);
+        twx_set_root(w[i & 1]);
+        if (step_end(b)) return 1;
+    }
+    report(b, "blank_fill", now_us() - t0);
+    return 0;
+}
+
+static scenario_t scenarios[] =
+{
+    { "htxt_set_content_1m", set_content },
+    { "htxt_log_tail_10k", log_tail },
+    { "itxt_typing_1k_per_s", typing },
+    { "resize_storm", resize_storm },
+    { "blank_fill", blank_fill },
+};
+
+/* main *********************************************************************/
+int main (int argc, char const * const * argv)
+{
+    bench_t * b;
+    size_t i;
+    int j, rc = 0;
+
+    b = malloc(sizeof(bench_t));
+    if (!b) return 1;
+    printf("{\"lib\":\"%s\",\"height\":%u,\"width\":%u}\n",
+           twx_lib_name, BENCH_HEIGHT, BENCH_WIDTH);
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i)
+    {
+        for (j = 1; j < argc && strcmp(argv[j], scenarios[i].name); ++j);
+        if (argc > 1 && j == argc) continue;
+        if (bench_init(b)) { rc = 1; break; }
+        if (scenarios[i].run(b))
+        {
+            fprintf(stderr, "scenario %s failed\n", scenarios[i].name);
+            rc = 1;
+        }
+        bench_finish(b);
+    }
+    free(b);
+    return rc;
+}
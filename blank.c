@@ -17,7 +17,7 @@ twx_status_t ZLX_CALL blank_handler (twx_win_t * win, unsigned int evt,
                                      twx_event_info_t * ei)
 {
     blank_win_t * bw = (blank_win_t *) win;
-    unsigned int i, cs;
+    unsigned int i, top, bottom;
     twx_status_t ts = TWX_OK;
 
     (void) ei;
@@ -25,15 +25,13 @@ twx_status_t ZLX_CALL blank_handler (twx_win_t * win, unsigned int evt,
     {
     case TWX_DRAW:
         if (!(win->flags & TWX_WF_UPDATE)) break;
-        win->flags &= ~TWX_WF_UPDATE;
+        win_draw_begin(win, &top, &bottom);
         L("drawing a blank here %u+%u+%ux%u:'%c'...",
           win->scr_col, win->scr_row, win->width, win->height, bw->ch);
-        O(acx1_attr(bw->attr->bg, bw->attr->fg, bw->attr->mode));
-        for (i = 0; i < win->height; ++i) 
-        {
-            O(acx1_write_pos(win->scr_row + i, win->scr_col));
-            O(acx1_fill(bw->ch, win->width));
-        }
+        for (i = top; i < bottom; ++i) 
+            fb_fill(win->twx, win->scr_row + i, win->scr_col, win->width,
+                    bw->ch, bw->attr);
+        win_draw_end(win);
         bw->ch++;
         break;
     default:
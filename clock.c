@@ -0,0 +1,176 @@
+#if _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#endif
+#include "intern.h"
+
+/* clock_us *****************************************************************/
+uint64_t clock_us (void)
+{
+#if _WIN32
+    LARGE_INTEGER f, c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (uint64_t) (c.QuadPart / f.QuadPart) * 1000000
+        + (uint64_t) (c.QuadPart % f.QuadPart) * 1000000 / f.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+#endif
+}
+
+/* clock_ns *****************************************************************/
+uint64_t clock_ns (void)
+{
+#if _WIN32
+    LARGE_INTEGER f, c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (uint64_t) (c.QuadPart / f.QuadPart) * 1000000000
+        + (uint64_t) (c.QuadPart % f.QuadPart) * 1000000000 / f.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+#endif
+}
+
+/* clock_nap ****************************************************************/
+void clock_nap (unsigned int usec)
+{
+#if _WIN32
+    Sleep((usec + 999) / 1000);
+#else
+    struct timespec t;
+    t.tv_sec = usec / 1000000;
+    t.tv_nsec = (long) (usec % 1000000) * 1000;
+    nanosleep(&t, NULL);
+#endif
+}
+
+/* twx_tcond_s **************************************************************/
+/**
+ *  Lock and condition variable with a timed wait, which hbs does not have.
+ */
+struct twx_tcond_s
+{
+#if _WIN32
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t cond; // times out on CLOCK_MONOTONIC, like clock_us()
+#endif
+};
+
+/* tcond_create *************************************************************/
+twx_status_t tcond_create (twx_tcond_t * * tc_ptr)
+{
+    twx_tcond_t * tc;
+#if !_WIN32
+    pthread_condattr_t ca;
+    int e;
+#endif
+
+    tc = hbs_alloc(sizeof(twx_tcond_t), "twx.tcond");
+    if (!tc) return TWX_NO_MEM;
+#if _WIN32
+    InitializeCriticalSection(&tc->lock);
+    InitializeConditionVariable(&tc->cond);
+#else
+    if (pthread_mutex_init(&tc->lock, NULL))
+    {
+        hbs_free(tc, sizeof(twx_tcond_t));
+        return TWX_MAIN_COND_INIT_FAILED;
+    }
+    e = pthread_condattr_init(&ca);
+    if (!e)
+    {
+        e = pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+        if (!e) e = pthread_cond_init(&tc->cond, &ca);
+        pthread_condattr_destroy(&ca);
+    }
+    if (e)
+    {
+        L("ouch: %d", e);
+        pthread_mutex_destroy(&tc->lock);
+        hbs_free(tc, sizeof(twx_tcond_t));
+        return e == ENOMEM ? TWX_NO_MEM : TWX_MAIN_COND_INIT_FAILED;
+    }
+#endif
+    *tc_ptr = tc;
+    return TWX_OK;
+}
+
+/* tcond_destroy ************************************************************/
+void tcond_destroy (twx_tcond_t * tc)
+{
+#if _WIN32
+    DeleteCriticalSection(&tc->lock);
+#else
+    pthread_cond_destroy(&tc->cond);
+    pthread_mutex_destroy(&tc->lock);
+#endif
+    hbs_free(tc, sizeof(twx_tcond_t));
+}
+
+/* tcond_lock ***************************************************************/
+void tcond_lock (twx_tcond_t * tc)
+{
+#if _WIN32
+    EnterCriticalSection(&tc->lock);
+#else
+    pthread_mutex_lock(&tc->lock);
+#endif
+}
+
+/* tcond_unlock *************************************************************/
+void tcond_unlock (twx_tcond_t * tc)
+{
+#if _WIN32
+    LeaveCriticalSection(&tc->lock);
+#else
+    pthread_mutex_unlock(&tc->lock);
+#endif
+}
+
+/* tcond_signal *************************************************************/
+void tcond_signal (twx_tcond_t * tc)
+{
+#if _WIN32
+    WakeConditionVariable(&tc->cond);
+#else
+    pthread_cond_signal(&tc->cond);
+#endif
+}
+
+/* tcond_wait ***************************************************************/
+void tcond_wait (twx_tcond_t * tc, uint64_t at)
+{
+#if _WIN32
+    uint64_t now;
+    if (!at)
+    {
+        SleepConditionVariableCS(&tc->cond, &tc->lock, INFINITE);
+        return;
+    }
+    now = clock_us();
+    if (now < at)
+        SleepConditionVariableCS(&tc->cond, &tc->lock,
+                                 (DWORD) ((at - now + 999) / 1000));
+#else
+    struct timespec t;
+    if (!at)
+    {
+        pthread_cond_wait(&tc->cond, &tc->lock);
+        return;
+    }
+    t.tv_sec = at / 1000000;
+    t.tv_nsec = (long) (at % 1000000) * 1000;
+    pthread_cond_timedwait(&tc->cond, &tc->lock, &t);
+#endif
+}
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+#define TI_SIZE_MAX 0x8000 // largest compiled terminfo entry
+#define TI_REP 121 // index of rep (repeat_char) in the terminfo strings
+
+static unsigned int ZLX_CALL console_init (twx_backend_t * be);
+static void ZLX_CALL console_finish (twx_backend_t * be);
+static unsigned int ZLX_CALL console_read_event (twx_backend_t * be,
+                                                 acx1_event_t * e);
+static unsigned int ZLX_CALL console_get_screen_size (twx_backend_t * be,
+                                                      uint16_t * h,
+                                                      uint16_t * w);
+static unsigned int ZLX_CALL console_write_start (twx_backend_t * be);
+static unsigned int ZLX_CALL console_write_stop (twx_backend_t * be);
+static unsigned int ZLX_CALL console_attr (twx_backend_t * be,
+                                           unsigned int bg, unsigned int fg,
+                                           unsigned int mode);
+static unsigned int ZLX_CALL console_clear (twx_backend_t * be);
+static unsigned int ZLX_CALL console_set_cursor_mode (twx_backend_t * be,
+                                                      unsigned int mode);
+static unsigned int ZLX_CALL console_set_cursor_pos (twx_backend_t * be,
+                                                     unsigned int row,
+                                                     unsigned int col);
+static unsigned int ZLX_CALL console_write_pos (twx_backend_t * be,
+                                                unsigned int row,
+                                                unsigned int col);
+static unsigned int ZLX_CALL console_write (twx_backend_t * be,
+                                            void const * data, size_t size);
+
+static twx_backend_class_t console_bcls =
+{
+    console_init,
+    console_finish,
+    console_read_event,
+    console_get_screen_size,
+    console_write_start,
+    console_write_stop,
+    console_attr,
+    console_clear,
+    console_set_cursor_mode,
+    console_set_cursor_pos,
+    console_write_pos,
+    console_write,
+    "acx1"
+};
+
+twx_backend_t console_backend =
+{
+    &console_bcls,
+#if !_WIN32
+    TWX_CAP_SCROLL_REGION | TWX_CAP_VT | TWX_CAP_SYNC |
+#endif
+#if TWX_BRACKETED_PASTE
+    TWX_CAP_PASTE |
+#endif
+    0
+};
+
+#if !_WIN32
+
+/* ti_le16 ******************************************************************/
+ZLX_INLINE unsigned int ti_le16 (uint8_t const * p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/* ti_open ******************************************************************/
+/**
+ *  Opens the compiled terminfo entry of a terminal found in the first dn
+ *  bytes of dir, under the first letter of the name or its hex code.
+ */
+static FILE * ti_open (char const * dir, size_t dn, char const * term)
+{
+    char path[1024];
+    FILE * f;
+
+    if (!dn || dn + strlen(term) + 5 > sizeof(path)) return NULL;
+    sprintf(path, "%.*s/%c/%s", (int) dn, dir, term[0], term);
+    f = fopen(path, "rb");
+    if (f) return f;
+    sprintf(path, "%.*s/%02x/%s", (int) dn, dir, (uint8_t) term[0], term);
+    return fopen(path, "rb");
+}
+
+/* ti_find ******************************************************************/
+/**
+ *  Opens the terminfo entry of a terminal, searching the same directories
+ *  as ncurses.
+ */
+static FILE * ti_find (char const * term)
+{
+    static char const * const sys_dirs[] =
+    {
+        "/etc/terminfo", "/lib/terminfo", "/usr/share/terminfo",
+        "/usr/lib/terminfo",
+    };
+    char home[1024];
+    char const * d;
+    char const * e;
+    FILE * f = NULL;
+    size_t i;
+
+    if ((d = getenv("TERMINFO")) && (f = ti_open(d, strlen(d), term)))
+        return f;
+    if ((d = getenv("HOME")) && strlen(d) + 10 < sizeof(home))
+    {
+        sprintf(home, "%s/.terminfo", d);
+        if ((f = ti_open(home, strlen(home), term))) return f;
+    }
+    for (d = getenv("TERMINFO_DIRS"); d && *d && !f; d = *e ? e + 1 : e)
+    {
+        e = strchr(d, ':');
+        if (!e) e = d + strlen(d);
+        f = ti_open(d, e - d, term);
+    }
+    for (i = 0; !f && i < sizeof(sys_dirs) / sizeof(sys_dirs[0]); ++i)
+        f = ti_open(sys_dirs[i], strlen(sys_dirs[i]), term);
+    return f;
+}
+
+/* ti_has_rep ***************************************************************/
+/**
+ *  Tells whether the terminfo entry of the terminal has rep in the CSI b
+ *  form the output encoder sends. Terminals announcing themselves as
+ *  xterm-256color and the like often lack REP, and losing repeated chars
+ *  there would go unnoticed, so REP is used only when terminfo has it.
+ */
+static int ti_has_rep (char const * term)
+{
+    uint8_t * b;
+    uint8_t const * p;
+    uint8_t const * q;
+    FILE * f;
+    size_t n, o, k, strs, tab;
+    int rep = 0;
+
+    if (!term || !*term || strchr(term, '/')) return 0;
+    f = ti_find(term);
+    if (!f) return 0;
+    b = hbs_alloc(TI_SIZE_MAX, "twx.terminfo");
+    n = b ? fread(b, 1, TI_SIZE_MAX, f) : 0;
+    fclose(f);
+    do
+    {
+        /* header: magic (0432 for 16-bit numbers, 01036 for 32-bit ones),
+         * name bytes, bools, numbers, strings, string table bytes */
+        if (n < 12) break;
+        k = ti_le16(b);
+        if (k != 0432 && k != 01036) break;
+        o = 12 + ti_le16(b + 2) + ti_le16(b + 4);
+        o += o & 1;
+        o += ti_le16(b + 6) * (k == 0432 ? 2 : 4);
+        strs = ti_le16(b + 8);
+        tab = ti_le16(b + 10);
+        if (strs <= TI_REP || o + strs * 2 + tab > n) break;
+        k = ti_le16(b + o + TI_REP * 2);
+        if (k >= tab) break; // absent or cancelled
+        p = b + o + strs * 2 + k;
+        q = memchr(p, 0, tab - k);
+        rep = q && q > p && q[-1] == 'b'
+            && strstr((char const *) p, "\x1B[");
+    }
+    while (0);
+    if (b) hbs_free(b, TI_SIZE_MAX);
+    return rep;
+}
+
+#endif
+
+/* console_init *************************************************************/
+static unsigned int ZLX_CALL console_init (twx_backend_t * be)
+{
+#if !_WIN32
+    if (ti_has_rep(getenv("TERM"))) be->caps |= TWX_CAP_REP;
+#else
+    (void) be;
+#endif
+    return acx1_init();
+}
+
+/* console_finish ***********************************************************/
+static void ZLX_CALL console_finish (twx_backend_t * be)
+{
+    (void) be;
+    acx1_finish();
+}
+
+/* console_read_event *******************************************************/
+static unsigned int ZLX_CALL console_read_event (twx_backend_t * be,
+                                                 acx1_event_t * e)
+{
+    (void) be;
+    return acx1_read_event(e);
+}
+
+/* console_get_screen_size **************************************************/
+static unsigned int ZLX_CALL console_get_screen_size (twx_backend_t * be,
+                                                      uint16_t * h,
+                                                      uint16_t * w)
+{
+    (void) be;
+    return acx1_get_screen_size(h, w);
+}
+
+/* console_write_start ******************************************************/
+static unsigned int ZLX_CALL console_write_start (twx_backend_t * be)
+{
+    (void) be;
+    return acx1_write_start();
+}
+
+/* console_write_stop *******************************************************/
+static unsigned int ZLX_CALL console_write_stop (twx_backend_t * be)
+{
+    (void) be;
+    return acx1_write_stop();
+}
+
+/* console_attr *************************************************************/
+static unsigned int ZLX_CALL console_attr (twx_backend_t * be,
+                                           unsigned int bg, unsigned int fg,
+                                           unsigned int mode)
+{
+    (void) be;
+    return acx1_attr(bg, fg, mode);
+}
+
+/* console_clear ************************************************************/
+static unsigned int ZLX_CALL console_clear (twx_backend_t * be)
+{
+    (void) be;
+    return acx1_clear();
+}
+
+/* console_set_cursor_mode **************************************************/
+static unsigned int ZLX_CALL console_set_cursor_mode (twx_backend_t * be,
+                                                      unsigned int mode)
+{
+    (void) be;
+    return acx1_set_cursor_mode(mode);
+}
+
+/* console_set_cursor_pos ***************************************************/
+static unsigned int ZLX_CALL console_set_cursor_pos (twx_backend_t * be,
+                                                     unsigned int row,
+                                                     unsigned int col)
+{
+    (void) be;
+    return acx1_set_cursor_pos(row, col);
+}
+
+/* console_write_pos ********************************************************/
+static unsigned int ZLX_CALL console_write_pos (twx_backend_t * be,
+                                                unsigned int row,
+                                                unsigned int col)
+{
+    (void) be;
+    return acx1_write_pos(row, col);
+}
+
+/* console_write ************************************************************/
+static unsigned int ZLX_CALL console_write (twx_backend_t * be,
+                                            void const * data, size_t size)
+{
+    (void) be;
+    return acx1_write(data, size);
+}
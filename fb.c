@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <string.h>
+#include "intern.h"
+
+/* max number of unchanged cells to resend instead of repositioning the
+ * cursor when two changed runs are this close on the same row */
+#define FB_GAP 6
+
+/* code point that never matches a rendered cell */
+#define FB_STALE 0xFFFFFFFF
+
+/* cell_eq ******************************************************************/
+ZLX_INLINE int cell_eq (twx_cell_t const * a, twx_cell_t const * b)
+{
+    return a->ch == b->ch && a->cm == b->cm && a->w == b->w
+        && a->bg == b->bg && a->fg == b->fg && a->mode == b->mode;
+}
+
+/* cell_set *****************************************************************/
+ZLX_INLINE void cell_set (twx_cell_t * c, uint32_t ch, unsigned int w,
+                          uint8_t bg, uint8_t fg, uint8_t mode)
+{
+    c->ch = ch;
+    c->cm = 0;
+    c->w = w;
+    c->bg = bg;
+    c->fg = fg;
+    c->mode = mode;
+}
+
+/* cell_blank ***************************************************************/
+ZLX_INLINE void cell_blank (twx_cell_t * c)
+{
+    c->ch = ' ';
+    c->cm = 0;
+    c->w = 1;
+}
+
+/* blank_fill ***************************************************************/
+static void blank_fill (twx_cell_t * c, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; ++i) cell_set(&c[i], ' ', 1, 0, 7, 0);
+}
+
+/* fb_resize ****************************************************************/
+twx_status_t fb_resize (twx_t * twx, unsigned int height, unsigned int width)
+{
+    size_t n = (size_t) height * width;
+
+    if (n > twx->fb_size)
+    {
+        fb_free(twx);
+        twx->fb_back = hbs_alloc(n * sizeof(twx_cell_t), "twx.fb.back");
+        if (!twx->fb_back) return TWX_NO_MEM;
+        twx->fb_front = hbs_alloc(n * sizeof(twx_cell_t), "twx.fb.front");
+        if (!twx->fb_front)
+        {
+            hbs_free(twx->fb_back, n * sizeof(twx_cell_t));
+            twx->fb_back = NULL;
+            return TWX_NO_MEM;
+        }
+        twx->fb_size = n;
+    }
+    twx->fb_height = height;
+    twx->fb_width = width;
+    blank_fill(twx->fb_back, n);
+    blank_fill(twx->fb_front, n);
+    twx->fb_dirty_top = height;
+    twx->fb_dirty_end = 0;
+    twx->clip_top = twx->clip_left = 0;
+    twx->clip_bottom = height;
+    twx->clip_right = width;
+    twx->fb_clear = 1;
+    twx->fb_scroll_n = 0;
+    twx->out_row = 0;
+    return TWX_OK;
+}
+
+/* fb_free ******************************************************************/
+void fb_free (twx_t * twx)
+{
+    if (!twx->fb_size) return;
+    hbs_free(twx->fb_back, twx->fb_size * sizeof(twx_cell_t));
+    hbs_free(twx->fb_front, twx->fb_size * sizeof(twx_cell_t));
+    twx->fb_back = twx->fb_front = NULL;
+    twx->fb_size = 0;
+    twx->fb_height = twx->fb_width = 0;
+}
+
+/* fb_dirty *****************************************************************/
+ZLX_INLINE void fb_dirty (twx_t * twx, unsigned int r)
+{
+    if (twx->fb_dirty_top > r) twx->fb_dirty_top = r;
+    if (twx->fb_dirty_end <= r) twx->fb_dirty_end = r + 1;
+}
+
+/* fb_put *******************************************************************/
+/**
+ *  Stores a char in the back grid at 0-based row r, column c.
+ *  Blanks the halves of double-width chars that get partially overwritten.
+ */
+static twx_cell_t * fb_put (twx_t * twx, unsigned int r, unsigned int c,
+                            uint32_t ch, unsigned int w,
+                            acx1_attr_t const * attr)
+{
+    unsigned int fw = twx->fb_width;
+    twx_cell_t * row = twx->fb_back + (size_t) r * fw;
+
+    if (w == 2 && c + 1 >= fw) { ch = ' '; w = 1; }
+    if (row[c].w == 0 && c) cell_blank(&row[c - 1]);
+    if (row[c].w == 2 && w == 1) cell_blank(&row[c + 1]);
+    cell_set(&row[c], ch, w, attr->bg, attr->fg, attr->mode);
+    if (w == 2)
+    {
+        if (row[c + 1].w == 2) cell_blank(&row[c + 2]);
+        cell_set(&row[c + 1], 0, 0, attr->bg, attr->fg, attr->mode);
+    }
+    return &row[c];
+}
+
+/* fb_fill ******************************************************************/
+void fb_fill (twx_t * twx, unsigned int row, unsigned int col, unsigned int n,
+              uint32_t ch, acx1_attr_t const * attr)
+{
+    unsigned int r, c, e;
+    int cw;
+
+    if (row <= twx->clip_top || row > twx->clip_bottom || !col) return;
+    r = row - 1;
+    c = col - 1;
+    e = c + n;
+    if (c < twx->clip_left) c = twx->clip_left;
+    if (e > twx->clip_right) e = twx->clip_right;
+    if (c >= e) return;
+
+    cw = ucd_width(ch);
+    if (cw != 1 && cw != 2) { ch = ' '; cw = 1; }
+    for (; c + cw <= e; c += cw) fb_put(twx, r, c, ch, cw, attr);
+    if (c < e) fb_put(twx, r, c, ' ', 1, attr);
+    fb_dirty(twx, r);
+}
+
+/* fb_write *****************************************************************/
+unsigned int fb_write (twx_t * twx, unsigned int row, unsigned int col,
+                       unsigned int width, uint8_t const * text, size_t len,
+                       acx1_attr_t const * attr)
+{
+    uint8_t const * p = text;
+    uint8_t const * e = text + len;
+    twx_cell_t * last = NULL;
+    unsigned int r, c, n, k;
+    uint32_t ucp;
+    ptrdiff_t l;
+    int cw, vis;
+
+    vis = row > twx->clip_top && row <= twx->clip_bottom;
+    r = row - 1;
+    c = col - 1;
+    for (n = 0; p < e; p += l)
+    {
+        if (*p >= 0x20 && *p < 0x7F)
+        {
+            /* printable ASCII run: one cell per byte, nothing to decode */
+            l = scan_ascii(p, e) - p;
+            if ((size_t) l > width - n) l = width - n;
+            if (!l) break;
+            for (k = 0; k < (unsigned int) l; ++k, ++n)
+            {
+                if (vis && c + n + 1 > twx->clip_left && c + n < twx->clip_right
+                    && c + n + 1 <= twx->fb_width)
+                    last = fb_put(twx, r, c + n, p[k], 1, attr);
+                else last = NULL;
+            }
+            continue;
+        }
+        l = zlx_utf8_to_ucp(p, e, 0, &ucp);
+        if (l <= 0) { l = 1; ucp = '?'; }
+        cw = ucd_width(ucp);
+        if (cw < 0) { ucp = '?'; cw = 1; }
+        if (cw == 0)
+        {
+            if (last && !last->cm) last->cm = ucp;
+            continue;
+        }
+        if (n + cw > width) break;
+        if (vis && c + n + cw > twx->clip_left && c + n < twx->clip_right
+            && c + n + cw <= twx->fb_width)
+            last = fb_put(twx, r, c + n, ucp, cw, attr);
+        else last = NULL;
+        n += cw;
+    }
+    if (vis && n) fb_dirty(twx, r);
+    return n;
+}
+
+/* fb_scroll ****************************************************************/
+void fb_scroll (twx_t * twx, unsigned int row, unsigned int col,
+                unsigned int height, unsigned int width, int n)
+{
+    unsigned int t, b, c, e, k, r, fw = twx->fb_width;
+    fb_scroll_t * op;
+    twx_cell_t * g;
+
+    if (!row || row > twx->fb_height || !col || col > fw || !n) return;
+    t = row - 1;
+    b = t + height;
+    if (b > twx->fb_height) b = twx->fb_height;
+    c = col - 1;
+    e = c + width;
+    if (e > fw) e = fw;
+    k = n > 0 ? (unsigned int) n : (unsigned int) -n;
+    if (k >= b - t) return;
+
+    for (r = 0; r < b - t - k; ++r)
+    {
+        g = twx->fb_back + (size_t) (n > 0 ? t + r : b - 1 - r) * fw;
+        memcpy(g + c, g + (n > 0 ? (ptrdiff_t) k : -(ptrdiff_t) k) * fw + c,
+               (e - c) * sizeof(twx_cell_t));
+    }
+    fb_dirty(twx, t);
+    fb_dirty(twx, b - 1);
+
+    /* scroll regions span whole rows */
+    if (c || e < fw || !(twx->caps & TWX_CAP_SCROLL_REGION) || twx->fb_clear
+        || twx->fb_scroll_n == TWX_FB_SCROLL_MAX) return;
+
+    g = twx->fb_front;
+    if (n > 0)
+        memmove(g + (size_t) t * fw, g + (size_t) (t + k) * fw,
+                (size_t) (b - t - k) * fw * sizeof(twx_cell_t));
+    else
+        memmove(g + (size_t) (t + k) * fw, g + (size_t) t * fw,
+                (size_t) (b - t - k) * fw * sizeof(twx_cell_t));
+    /* the terminal fills the exposed rows with whatever it likes */
+    g += (size_t) (n > 0 ? b - k : t) * fw;
+    for (k *= fw; k; --k, ++g) g->ch = FB_STALE, g->w = 1;
+
+    op = &twx->fb_scroll_a[twx->fb_scroll_n++];
+    op->top = t;
+    op->bottom = b;
+    op->n = n;
+}
+
+/* fb_cursor ****************************************************************/
+void fb_cursor (twx_t * twx, unsigned int row, unsigned int col)
+{
+    /* the terminal stops the cursor at the edge of the screen; recording a
+     * position past it would throw off the next relative move */
+    if (row > twx->fb_height) row = twx->fb_height;
+    if (col > twx->fb_width) col = twx->fb_width;
+    twx->cursor_row = row;
+    twx->cursor_col = col;
+}
+
+/* win_draw_begin ***********************************************************/
+void win_draw_begin (twx_win_t * win, unsigned int * top,
+                     unsigned int * bottom)
+{
+    twx_t * twx = win->twx;
+    unsigned int r, c, h, w;
+
+    if (win->dmg_height && win->dmg_width)
+    {
+        r = win->dmg_row;
+        c = win->dmg_col;
+        h = win->dmg_height;
+        w = win->dmg_width;
+    }
+    else
+    {
+        r = win->scr_row;
+        c = win->scr_col;
+        h = win->height;
+        w = win->width;
+    }
+    win->flags &= ~TWX_WF_UPDATE;
+    win->dmg_height = win->dmg_width = 0;
+
+    *top = r - win->scr_row;
+    *bottom = *top + h;
+
+    twx->clip_top = r - 1;
+    twx->clip_bottom = r - 1 + h;
+    if (twx->clip_bottom > twx->fb_height) twx->clip_bottom = twx->fb_height;
+    twx->clip_left = c - 1;
+    twx->clip_right = c - 1 + w;
+    if (twx->clip_right > twx->fb_width) twx->clip_right = twx->fb_width;
+}
+
+/* win_draw_end *************************************************************/
+void win_draw_end (twx_win_t * win)
+{
+    twx_t * twx = win->twx;
+    twx->clip_top = twx->clip_left = 0;
+    twx->clip_bottom = twx->fb_height;
+    twx->clip_right = twx->fb_width;
+}
+
+/* emit_run *****************************************************************/
+/**
+ *  Sends cells [s, e) of 0-based row r from the back grid to the terminal.
+ */
+static unsigned int emit_run (twx_t * twx, unsigned int r,
+                              unsigned int s, unsigned int e)
+{
+    unsigned int cs;
+
+    cs = out_move(twx, r + 1, s + 1);
+    if (cs) return cs;
+    return out_cells(twx, twx->fb_back + (size_t) r * twx->fb_width + s,
+                     e - s);
+}
+
+/* fb_flush *****************************************************************/
+twx_status_t fb_flush (twx_t * twx)
+{
+    twx_cell_t * b;
+    twx_cell_t * f;
+    unsigned int r, c, s, e, l, w = twx->fb_width, cs = 0;
+    int out = 0;
+
+    do
+    {
+        for (r = 0; r < twx->fb_scroll_n; ++r)
+        {
+            fb_scroll_t * op = &twx->fb_scroll_a[r];
+            char esc[40];
+            int l;
+            l = sprintf(esc, "\x1B[%u;%ur\x1B[%u%c\x1B[r",
+                        op->top + 1, op->bottom,
+                        op->n > 0 ? op->n : -op->n, op->n > 0 ? 'S' : 'T');
+            cs = out_raw(twx, esc, l);
+            if (cs) break;
+            out = 1;
+        }
+        twx->fb_scroll_n = 0;
+        if (cs) break;
+
+        if (twx->fb_clear)
+        {
+            cs = out_attr(twx, 0, 7, 0);
+            if (cs) break;
+            cs = out_clear(twx);
+            if (cs) break;
+            twx->fb_clear = 0;
+            out = 1;
+        }
+
+        for (r = twx->fb_dirty_top; r < twx->fb_dirty_end; ++r)
+        {
+            b = twx->fb_back + (size_t) r * w;
+            f = twx->fb_front + (size_t) r * w;
+            for (c = 0; c < w; )
+            {
+                if (cell_eq(&b[c], &f[c])) { ++c; continue; }
+                s = c;
+                if (!b[s].w && s) --s;
+                for (l = c, e = c + 1; e < w && e - l <= FB_GAP; ++e)
+                    if (!cell_eq(&b[e], &f[e])) l = e;
+                e = l + 1;
+                if (b[l].w == 2 && e < w) ++e;
+                L2("row %u: run %u..%u", r, s, e);
+                cs = emit_run(twx, r, s, e);
+                if (cs) break;
+                memcpy(f + s, b + s, (e - s) * sizeof(twx_cell_t));
+                out = 1;
+                c = e;
+            }
+            if (cs) break;
+        }
+        if (cs) break;
+        twx->fb_dirty_top = twx->fb_height;
+        twx->fb_dirty_end = 0;
+
+        if (twx->cursor_row && (out || twx->cursor_row != twx->out_row
+                                || twx->cursor_col != twx->out_col))
+        {
+            cs = out_cursor(twx, twx->cursor_row, twx->cursor_col);
+            if (cs) break;
+        }
+    }
+    while (0);
+
+    if (cs)
+    {
+        L("console output error %u", cs);
+        return TWX_CONSOLE_OUTPUT_ERROR;
+    }
+    return TWX_OK;
+}
@@ -0,0 +1,215 @@
+#if _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "intern.h"
+
+#define FVIEW_FIRST_CHUNK 0x10000 // indexed before the window is returned
+#define FVIEW_CHUNK 0x400000 // indexed by the thread between updates
+#define FVIEW_RETRY_US 1000 // wait before posting the last progress again
+
+void ZLX_CALL fview_finish (twx_win_t * win);
+
+twx_win_class_t fview_wcls =
+{
+    htxt_handler,
+    fview_finish,
+    sizeof(fview_win_t),
+    "txt/fview"
+};
+
+/* fview_unmap **************************************************************/
+static void fview_unmap (fview_win_t * fw)
+{
+#if _WIN32
+    if (fw->data) UnmapViewOfFile(fw->data);
+    if (fw->map) CloseHandle(fw->map);
+#else
+    if (fw->size) munmap((void *) fw->data, fw->size);
+#endif
+}
+
+/* fview_finish *************************************************************/
+void ZLX_CALL fview_finish (twx_win_t * win)
+{
+    fview_win_t * fw = (fview_win_t *) win;
+
+    if (fw->thread_started)
+    {
+        ATOMIC_STORE(&fw->cancel, 1);
+        hbs_thread_join(fw->index_thread, NULL);
+    }
+    if (fw->htxt.mutex) htxt_finish(win);
+    fview_unmap(fw);
+}
+
+/* fview_map ****************************************************************/
+/**
+ *  Maps the whole file read-only.
+ */
+static twx_status_t fview_map (fview_win_t * fw, char const * path)
+{
+#if _WIN32
+    HANDLE f;
+    LARGE_INTEGER size;
+
+    f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                    NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (f == INVALID_HANDLE_VALUE) return TWX_FILE_ERROR;
+    if (!GetFileSizeEx(f, &size) || (uint64_t) size.QuadPart > SIZE_MAX)
+    {
+        CloseHandle(f);
+        return TWX_FILE_ERROR;
+    }
+    fw->size = (size_t) size.QuadPart;
+    if (fw->size)
+    {
+        fw->map = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (fw->map)
+            fw->data = MapViewOfFile(fw->map, FILE_MAP_READ, 0, 0, 0);
+    }
+    CloseHandle(f);
+    if (fw->size && !fw->data) return TWX_FILE_ERROR;
+#else
+    struct stat st;
+    void * p;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return TWX_FILE_ERROR;
+    if (fstat(fd, &st) || (uint64_t) st.st_size > SIZE_MAX)
+    {
+        close(fd);
+        return TWX_FILE_ERROR;
+    }
+    if (st.st_size)
+    {
+        p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) { close(fd); return TWX_FILE_ERROR; }
+        fw->data = p;
+        fw->size = (size_t) st.st_size;
+    }
+    close(fd);
+#endif
+    return TWX_OK;
+}
+
+/* fview_index **************************************************************/
+/**
+ *  Adds the rows found in about n bytes following the indexed part of the
+ *  file; the part indexed always ends after a new line or at the end of
+ *  the file.
+ */
+static twx_status_t fview_index (fview_win_t * fw, size_t n)
+{
+    uint8_t const * p = fw->data + fw->indexed;
+    uint8_t const * end = fw->data + fw->size;
+    uint8_t const * s;
+    uint8_t const * e;
+    uint8_t const * q;
+    twx_status_t ts;
+
+    for (s = p;; s = e)
+    {
+        e = (size_t) (end - s) > n ? s + n : end;
+        if (e == end) break;
+        for (q = e; q > s && (q[-1] != '\n' || htxt_nl_attr(s, q - 1)); --q);
+        if (q > s) { e = q; break; }
+        /* no new line in the chunk; take one more */
+    }
+    ts = htxt_append_ref(&fw->htxt, p, e);
+    if (ts) return ts;
+    ATOMIC_STORE(&fw->indexed, (size_t) (e - fw->data));
+    return TWX_OK;
+}
+
+/* fview_report *************************************************************/
+/**
+ *  Posts the indexing progress to the notification window.
+ *  If the post ring is full, the progress is dropped since the next one
+ *  supersedes it; the last one is retried if retry is set, until it gets
+ *  through or indexing is cancelled.
+ */
+static void fview_report (fview_win_t * fw, int retry)
+{
+    twx_event_info_t e;
+
+    if (!fw->ntf_win) return;
+    e.progress.id = fw->ntf_id;
+    e.progress.done = fw->indexed;
+    e.progress.total = fw->size;
+    while (twx_post_event(fw->ntf_win, TWX_FVIEW_PROGRESS, &e) == TWX_QUEUE_FULL
+           && retry && fw->indexed == fw->size && !ATOMIC_LOAD(&fw->cancel))
+        clock_nap(FVIEW_RETRY_US);
+}
+
+/* fview_indexer ************************************************************/
+static uint8_t ZLX_CALL fview_indexer (void * arg)
+{
+    fview_win_t * fw = arg;
+
+    while (!ATOMIC_LOAD(&fw->cancel) && fw->indexed < fw->size)
+    {
+        if (fview_index(fw, FVIEW_CHUNK))
+        {
+            L("indexing failed at %lu", (unsigned long) fw->indexed);
+            return 1;
+        }
+        fview_report(fw, 1);
+    }
+    return 0;
+}
+
+/* twx_fview_win_create *****************************************************/
+TWX_API twx_status_t ZLX_CALL twx_fview_win_create
+(
+    twx_t * twx,
+    twx_win_t * * win_ptr,
+    acx1_attr_t * attr_a,
+    size_t attr_n,
+    char const * path,
+    twx_win_t * ntf_win,
+    unsigned int ntf_id
+)
+{
+    fview_win_t * fw;
+    twx_status_t ts;
+
+    fw = win_alloc(twx, &fview_wcls);
+    if (!fw) return TWX_NO_MEM;
+    fw->ntf_win = ntf_win;
+    fw->ntf_id = ntf_id;
+    do
+    {
+        ts = htxt_init(&fw->htxt, attr_a, attr_n);
+        if (ts) break;
+        ts = fview_map(fw, path);
+        if (ts) break;
+        if (fw->indexed == fw->size) break;
+        ts = fview_index(fw, FVIEW_FIRST_CHUNK);
+        if (ts) break;
+        /* the caller may not run twx_run() yet; never wait for the ring */
+        fview_report(fw, 0);
+        if (fw->indexed == fw->size) break;
+        if (hbs_thread_create(&fw->index_thread, fview_indexer, fw))
+        {
+            ts = TWX_THREAD_CREATE_FAILED;
+            break;
+        }
+        fw->thread_started = 1;
+    }
+    while (0);
+
+    if (ts)
+    {
+        fview_finish(&fw->htxt.base);
+        hbs_free(fw, fview_wcls.size);
+        return ts;
+    }
+    *win_ptr = &fw->htxt.base;
+    return TWX_OK;
+}
@@ -0,0 +1,702 @@
+#include <stdio.h>
+#include <string.h>
+#include "intern.h"
+
+#define HEADLESS_QUEUE_POWER 8 // synthetic input events waiting at most
+#define HEADLESS_PAR_MAX 16 // parameters kept per control sequence
+
+/* parser states */
+#define HL_GROUND 0
+#define HL_ESC 1 // after ESC
+#define HL_CSI 2 // after ESC [
+
+typedef struct headless_s headless_t;
+typedef struct headless_cell_s headless_cell_t;
+
+struct headless_cell_s
+{
+    uint32_t ch; // 0 for the right half of a wide char
+    uint8_t bg, fg, mode;
+};
+
+struct headless_s
+{
+    twx_backend_t base;
+    zlx_mutex_t * mutex; // guards everything below
+    zlx_cond_t * cond; // signalled when an event is queued and on finish
+    twx_tcond_t * frame_cond; // signalled at the end of each frame and on
+    // finish; taken after mutex is released, never while holding it
+    acx1_event_t * q; // synthetic input ring
+    unsigned int qb, qe, qm;
+    headless_cell_t * cells;
+    size_t cell_n; // cells allocated
+    unsigned int height, width;
+    unsigned int row, col; // 0-based; col reaches width after the last col
+    unsigned int top, bottom; // scroll region rows [top, bottom)
+    headless_cell_t pen; // attribute given to printed and erased cells
+    uint32_t last; // last char printed, repeated by REP
+    uint32_t ucp; // UTF-8 char being decoded
+    unsigned int ucp_more; // continuation bytes still expected
+    unsigned int par[HEADLESS_PAR_MAX];
+    unsigned int parn;
+    twx_headless_stats_t total;
+    twx_headless_stats_t frame; // output since the last write_stop()
+    twx_headless_stats_t last_frame;
+    uint8_t state; // HL_xxx
+    uint8_t priv; // control sequence has a private marker
+    uint8_t finished;
+};
+
+static unsigned int ZLX_CALL headless_init (twx_backend_t * be);
+static void ZLX_CALL headless_finish (twx_backend_t * be);
+static unsigned int ZLX_CALL headless_read_event (twx_backend_t * be,
+                                                  acx1_event_t * e);
+static unsigned int ZLX_CALL headless_get_screen_size (twx_backend_t * be,
+                                                       uint16_t * h,
+                                                       uint16_t * w);
+static unsigned int ZLX_CALL headless_write_start (twx_backend_t * be);
+static unsigned int ZLX_CALL headless_write_stop (twx_backend_t * be);
+static unsigned int ZLX_CALL headless_attr (twx_backend_t * be,
+                                            unsigned int bg, unsigned int fg,
+                                            unsigned int mode);
+static unsigned int ZLX_CALL headless_clear (twx_backend_t * be);
+static unsigned int ZLX_CALL headless_set_cursor_mode (twx_backend_t * be,
+                                                       unsigned int mode);
+static unsigned int ZLX_CALL headless_set_cursor_pos (twx_backend_t * be,
+                                                      unsigned int row,
+                                                      unsigned int col);
+static unsigned int ZLX_CALL headless_write (twx_backend_t * be,
+                                             void const * data, size_t size);
+
+static twx_backend_class_t headless_bcls =
+{
+    headless_init,
+    headless_finish,
+    headless_read_event,
+    headless_get_screen_size,
+    headless_write_start,
+    headless_write_stop,
+    headless_attr,
+    headless_clear,
+    headless_set_cursor_mode,
+    headless_set_cursor_pos,
+    headless_set_cursor_pos, // a VT terminal has a single cursor
+    headless_write,
+    "headless"
+};
+
+/* blank ********************************************************************/
+/**
+ *  Erases n cells with the background of the pen, as VT terminals do.
+ */
+static void blank (headless_t * hl, headless_cell_t * c, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; ++i)
+    {
+        c[i].ch = ' ';
+        c[i].bg = hl->pen.bg;
+        c[i].fg = hl->pen.fg;
+        c[i].mode = 0;
+    }
+}
+
+/* scroll *******************************************************************/
+/**
+ *  Moves the rows of the scroll region up (n > 0) or down (n < 0).
+ */
+static void scroll (headless_t * hl, int n)
+{
+    unsigned int w = hl->width, h = hl->bottom - hl->top, k;
+    headless_cell_t * r = hl->cells + (size_t) hl->top * w;
+
+    k = (unsigned int) (n > 0 ? n : -n);
+    if (k > h) k = h;
+    if (n > 0)
+    {
+        memmove(r, r + (size_t) k * w, (size_t) (h - k) * w * sizeof(*r));
+        blank(hl, r + (size_t) (h - k) * w, (size_t) k * w);
+    }
+    else
+    {
+        memmove(r + (size_t) k * w, r, (size_t) (h - k) * w * sizeof(*r));
+        blank(hl, r, (size_t) k * w);
+    }
+}
+
+/* put **********************************************************************/
+/**
+ *  Prints a char at the cursor; chars not fitting on the row are dropped.
+ */
+static void put (headless_t * hl, uint32_t ucp)
+{
+    headless_cell_t * c;
+    int w = ucd_width(ucp);
+
+    if (w <= 0 || hl->col + w > hl->width) return;
+    c = hl->cells + (size_t) hl->row * hl->width + hl->col;
+    /* overwriting half of a wide char erases the other half */
+    if (!c->ch && hl->col) c[-1].ch = ' ';
+    if (hl->col + w < hl->width && !c[w].ch) c[w].ch = ' ';
+    c->ch = ucp;
+    c->bg = hl->pen.bg;
+    c->fg = hl->pen.fg;
+    c->mode = hl->pen.mode;
+    if (w == 2) { c[1] = c[0]; c[1].ch = 0; }
+    hl->col += w;
+    hl->last = ucp;
+}
+
+/* par **********************************************************************/
+static unsigned int par (headless_t * hl, unsigned int i, unsigned int def)
+{
+    return i < hl->parn && hl->par[i] ? hl->par[i] : def;
+}
+
+/* sgr **********************************************************************/
+static void sgr (headless_t * hl)
+{
+    unsigned int i, p;
+
+    for (i = 0; i < hl->parn || !i; ++i)
+    {
+        p = i < hl->parn ? hl->par[i] : 0;
+        if (p == 0) { hl->pen.bg = 0; hl->pen.fg = 7; hl->pen.mode = 0; }
+        else if (p == 1) hl->pen.mode |= 1;
+        else if (p == 4) hl->pen.mode |= 2;
+        else if (p == 5) hl->pen.mode |= 4;
+        else if (p == 7) hl->pen.mode |= 8;
+        else if (p == 22) hl->pen.mode &= ~1;
+        else if (p == 24) hl->pen.mode &= ~2;
+        else if (p == 25) hl->pen.mode &= ~4;
+        else if (p == 27) hl->pen.mode &= ~8;
+        else if (p >= 30 && p <= 37) hl->pen.fg = p - 30;
+        else if (p == 39) hl->pen.fg = 7;
+        else if (p >= 40 && p <= 47) hl->pen.bg = p - 40;
+        else if (p == 49) hl->pen.bg = 0;
+        else if (p >= 90 && p <= 97) hl->pen.fg = p - 90 + 8;
+        else if (p >= 100 && p <= 107) hl->pen.bg = p - 100 + 8;
+        else if ((p == 38 || p == 48) && i + 2 < hl->parn
+                 && hl->par[i + 1] == 5)
+        {
+            if (p == 38) hl->pen.fg = hl->par[i + 2];
+            else hl->pen.bg = hl->par[i + 2];
+            i += 2;
+        }
+    }
+}
+
+/* csi **********************************************************************/
+/**
+ *  Applies a complete control sequence ending with the given byte.
+ */
+static void csi (headless_t * hl, uint8_t fin)
+{
+    headless_cell_t * r = hl->cells + (size_t) hl->row * hl->width;
+    unsigned int n = par(hl, 0, 1), col, i;
+
+    if (hl->priv) return; // modes like cursor visibility or paste
+    col = hl->col < hl->width ? hl->col : hl->width - 1;
+    switch (fin)
+    {
+    case 'H':
+    case 'f':
+        hl->row = par(hl, 0, 1) - 1;
+        hl->col = par(hl, 1, 1) - 1;
+        break;
+    case 'A': hl->row = hl->row > n ? hl->row - n : 0; break;
+    case 'B': hl->row += n; break;
+    case 'C': hl->col = col + n; break;
+    case 'D': hl->col = col > n ? col - n : 0; break;
+    case 'G': hl->col = n - 1; break;
+    case 'd': hl->row = n - 1; break;
+    case 'J':
+        n = par(hl, 0, 0);
+        if (n == 0)
+            blank(hl, r + col, hl->cells + hl->cell_n - r - col);
+        else if (n == 1)
+            blank(hl, hl->cells, r + col + 1 - hl->cells);
+        else
+            blank(hl, hl->cells, (size_t) hl->height * hl->width);
+        return;
+    case 'K':
+        n = par(hl, 0, 0);
+        if (n == 0) blank(hl, r + col, hl->width - col);
+        else if (n == 1) blank(hl, r, col + 1);
+        else blank(hl, r, hl->width);
+        return;
+    case 'X':
+        blank(hl, r + col, n < hl->width - col ? n : hl->width - col);
+        return;
+    case 'b':
+        for (i = 0; i < n && hl->last; ++i) put(hl, hl->last);
+        return;
+    case 'm':
+        sgr(hl);
+        return;
+    case 'r':
+        hl->top = par(hl, 0, 1) - 1;
+        hl->bottom = par(hl, 1, hl->height);
+        if (hl->bottom > hl->height || hl->top + 1 >= hl->bottom)
+        {
+            hl->top = 0;
+            hl->bottom = hl->height;
+        }
+        hl->row = hl->col = 0;
+        return;
+    case 'S': scroll(hl, (int) n); return;
+    case 'T': scroll(hl, -(int) n); return;
+    default:
+        return;
+    }
+    /* only cursor movements get here */
+    ++hl->frame.cursor_moves;
+    if (hl->row >= hl->height) hl->row = hl->height - 1;
+    if (hl->col >= hl->width) hl->col = hl->width - 1;
+}
+
+/* feed *********************************************************************/
+/**
+ *  Counts the bytes sent to the terminal and applies them to the screen.
+ */
+static void feed (headless_t * hl, uint8_t const * p, size_t n)
+{
+    uint8_t const * e = p + n;
+    uint8_t b;
+
+    hl->frame.bytes += n;
+    for (; p < e; ++p)
+    {
+        b = *p;
+        switch (hl->state)
+        {
+        case HL_GROUND:
+            if (b >= 0x20 && b < 0x7F) put(hl, b);
+            else if (b >= 0xC0)
+            {
+                hl->ucp_more = b >= 0xF0 ? 3 : b >= 0xE0 ? 2 : 1;
+                hl->ucp = b & (0x3F >> hl->ucp_more);
+            }
+            else if (b >= 0x80)
+            {
+                if (!hl->ucp_more) break;
+                hl->ucp = (hl->ucp << 6) | (b & 0x3F);
+                if (!--hl->ucp_more) put(hl, hl->ucp);
+            }
+            else if (b == 0x1B) hl->state = HL_ESC;
+            else if (b == '\r') hl->col = 0;
+            else if (b == '\b' && hl->col) --hl->col;
+            else if (b == '\n')
+            {
+                if (hl->row + 1 == hl->bottom) scroll(hl, 1);
+                else if (hl->row + 1 < hl->height) ++hl->row;
+            }
+            break;
+        case HL_ESC:
+            if (b == '[')
+            {
+                hl->state = HL_CSI;
+                hl->parn = 0;
+                hl->par[0] = 0;
+                hl->priv = 0;
+                break;
+            }
+            ++hl->frame.escapes;
+            hl->state = HL_GROUND;
+            break;
+        case HL_CSI:
+            if (b >= '0' && b <= '9')
+            {
+                if (!hl->parn) hl->parn = 1;
+                if (hl->parn <= HEADLESS_PAR_MAX
+                    && hl->par[hl->parn - 1] < 10000)
+                    hl->par[hl->parn - 1] = hl->par[hl->parn - 1] * 10
+                        + (b - '0');
+            }
+            else if (b == ';')
+            {
+                if (!hl->parn) hl->parn = 1;
+                if (hl->parn < HEADLESS_PAR_MAX) hl->par[hl->parn] = 0;
+                ++hl->parn;
+            }
+            else if (b >= '<' && b <= '?') hl->priv = 1;
+            else if (b >= 0x40 && b <= 0x7E)
+            {
+                if (hl->parn > HEADLESS_PAR_MAX) hl->parn = HEADLESS_PAR_MAX;
+                ++hl->frame.escapes;
+                csi(hl, b);
+                hl->state = HL_GROUND;
+            }
+            break;
+        }
+    }
+}
+
+/* headless_init ************************************************************/
+static unsigned int ZLX_CALL headless_init (twx_backend_t * be)
+{
+    headless_t * hl = (headless_t *) be;
+
+    hbs_mutex_lock(hl->mutex);
+    hl->finished = 0;
+    hbs_mutex_unlock(hl->mutex);
+    return 0;
+}
+
+/* headless_finish **********************************************************/
+static void ZLX_CALL headless_finish (twx_backend_t * be)
+{
+    headless_t * hl = (headless_t *) be;
+
+    hbs_mutex_lock(hl->mutex);
+    hl->finished = 1;
+    hbs_mutex_unlock(hl->mutex);
+    hbs_cond_signal(hl->cond);
+    tcond_lock(hl->frame_cond);
+    tcond_signal(hl->frame_cond);
+    tcond_unlock(hl->frame_cond);
+}
+
+/* headless_read_event ******************************************************/
+static unsigned int ZLX_CALL headless_read_event (twx_backend_t * be,
+                                                  acx1_event_t * e)
+{
+    headless_t * hl = (headless_t *) be;
+
+    hbs_mutex_lock(hl->mutex);
+    while (!hl->finished && hl->qb == hl->qe)
+        hbs_cond_wait(hl->cond, hl->mutex);
+    if (hl->finished) e->type = ACX1_FINISH;
+    else *e = hl->q[hl->qb++ & hl->qm];
+    hbs_mutex_unlock(hl->mutex);
+    return 0;
+}
+
+/* headless_get_screen_size *************************************************/
+static unsigned int ZLX_CALL headless_get_screen_size (twx_backend_t * be,
+                                                       uint16_t * h,
+                                                       uint16_t * w)
+{
+    headless_t * hl = (headless_t *) be;
+
+    hbs_mutex_lock(hl->mutex);
+    *h = (uint16_t) hl->height;
+    *w = (uint16_t) hl->width;
+    hbs_mutex_unlock(hl->mutex);
+    return 0;
+}
+
+/* headless_write_start *****************************************************/
+static unsigned int ZLX_CALL headless_write_start (twx_backend_t * be)
+{
+    (void) be;
+    return 0;
+}
+
+/* headless_write_stop ******************************************************/
+/**
+ *  Closes the frame; output sent between frames is counted in the next one.
+ */
+static unsigned int ZLX_CALL headless_write_stop (twx_backend_t * be)
+{
+    headless_t * hl = (headless_t *) be;
+
+    hbs_mutex_lock(hl->mutex);
+    hl->frame.frames = 1;
+    hl->last_frame = hl->frame;
+    hl->total.frames += 1;
+    hl->total.bytes += hl->frame.bytes;
+    hl->total.escapes += hl->frame.escapes;
+    hl->total.cursor_moves += hl->frame.cursor_moves;
+    hl->total.writes += hl->frame.writes;
+    memset(&hl->frame, 0, sizeof(hl->frame));
+    hbs_mutex_unlock(hl->mutex);
+    tcond_lock(hl->frame_cond);
+    tcond_signal(hl->frame_cond);
+    tcond_unlock(hl->frame_cond);
+    return 0;
+}
+
+/* headless_attr ************************************************************/
+/**
+ *  Mode bits 0 - 3 are bold, underline, blink and reverse; colours 8 - 15
+ *  are the bright ones.
+ */
+static unsigned int ZLX_CALL headless_attr (twx_backend_t * be,
+                                            unsigned int bg, unsigned int fg,
+                                            unsigned int mode)
+{
+    static uint8_t const mode_sgr[4] = { 1, 4, 5, 7 };
+    headless_t * hl = (headless_t *) be;
+    char esc[64];
+    int l;
+    unsigned int i;
+
+    l = sprintf(esc, "\x1B[0");
+    for (i = 0; i < 4; ++i)
+        if ((mode & (1 << i))) l += sprintf(esc + l, ";%u", mode_sgr[i]);
+    if (fg < 8) l += sprintf(esc + l, ";%u", 30 + fg);
+    else if (fg < 16) l += sprintf(esc + l, ";%u", 90 + fg - 8);
+    else l += sprintf(esc + l, ";38;5;%u", fg & 0xFF);
+    if (bg < 8) l += sprintf(esc + l, ";%u", 40 + bg);
+    else if (bg < 16) l += sprintf(esc + l, ";%u", 100 + bg - 8);
+    else l += sprintf(esc + l, ";48;5;%u", bg & 0xFF);
+    esc[l++] = 'm';
+
+    hbs_mutex_lock(hl->mutex);
+    ++hl->frame.writes;
+    feed(hl, (uint8_t const *) esc, l);
+    hbs_mutex_unlock(hl->mutex);
+    return 0;
+}
+
+/* headless_clear ***********************************************************/
+static unsigned int ZLX_CALL headless_clear (twx_backend_t * be)
+{
+    return headless_write(be, "\x1B[2J", 4);
+}
+
+/* headless_set_cursor_mode *************************************************/
+static unsigned int ZLX_CALL headless_set_cursor_mode (twx_backend_t * be,
+                                                       unsigned int mode)
+{
+    return headless_write(be, mode ? "\x1B[?25h" : "\x1B[?25l", 6);
+}
+
+/* headless_set_cursor_pos **************************************************/
+static unsigned int ZLX_CALL headless_set_cursor_pos (twx_backend_t * be,
+                                                      unsigned int row,
+                                                      unsigned int col)
+{
+    char esc[32];
+    int l;
+
+    l = sprintf(esc, "\x1B[%u;%uH", row, col);
+    return headless_write(be, esc, l);
+}
+
+/* headless_write ***********************************************************/
+static unsigned int ZLX_CALL headless_write (twx_backend_t * be,
+                                             void const * data, size_t size)
+{
+    headless_t * hl = (headless_t *) be;
+
+    hbs_mutex_lock(hl->mutex);
+    ++hl->frame.writes;
+    feed(hl, data, size);
+    hbs_mutex_unlock(hl->mutex);
+    return 0;
+}
+
+/* headless_resize **********************************************************/
+/**
+ *  Changes the size of the screen keeping the top-left part of its content.
+ */
+static twx_status_t headless_resize (headless_t * hl, unsigned int height,
+                                     unsigned int width)
+{
+    headless_cell_t * c;
+    size_t n = (size_t) height * width;
+    unsigned int r, h, w;
+
+    c = hbs_alloc(n * sizeof(headless_cell_t), "twx.headless.cells");
+    if (!c) return TWX_NO_MEM;
+    hl->pen.bg = 0;
+    hl->pen.fg = 7;
+    hl->pen.mode = 0;
+    blank(hl, c, n);
+    if (hl->cells)
+    {
+        h = height < hl->height ? height : hl->height;
+        w = width < hl->width ? width : hl->width;
+        for (r = 0; r < h; ++r)
+            memcpy(c + (size_t) r * width, hl->cells + (size_t) r * hl->width,
+                   w * sizeof(headless_cell_t));
+        hbs_free(hl->cells, hl->cell_n * sizeof(headless_cell_t));
+    }
+    hl->cells = c;
+    hl->cell_n = n;
+    hl->height = height;
+    hl->width = width;
+    hl->top = 0;
+    hl->bottom = height;
+    if (hl->row >= height) hl->row = height - 1;
+    if (hl->col >= width) hl->col = width - 1;
+    return TWX_OK;
+}
+
+/* twx_headless_create ******************************************************/
+TWX_API twx_status_t ZLX_CALL twx_headless_create
+(
+    twx_backend_t * * be_ptr,
+    unsigned int height,
+    unsigned int width
+)
+{
+    headless_t * hl;
+    zlx_mth_status_t ths;
+    twx_status_t ts;
+
+    if (!height || !width || height > 0xFFFF || width > 0xFFFF)
+        return TWX_BAD_SIZE;
+    hbs_init();
+    hl = hbs_alloc(sizeof(headless_t), "twx.headless");
+    if (!hl) return TWX_NO_MEM;
+    memset(hl, 0, sizeof(*hl));
+    hl->base.bcls = &headless_bcls;
+    hl->base.caps = TWX_CAP_SCROLL_REGION | TWX_CAP_VT | TWX_CAP_REP
+        | TWX_CAP_SYNC;
+#if TWX_BRACKETED_PASTE
+    hl->base.caps |= TWX_CAP_PASTE;
+#endif
+    hl->qm = (1 << HEADLESS_QUEUE_POWER) - 1;
+    do
+    {
+        ts = TWX_NO_MEM;
+        hl->q = hbs_alloc(sizeof(acx1_event_t) * (hl->qm + 1),
+                          "twx.headless.queue");
+        if (!hl->q) break;
+        hl->mutex = hbs_mutex_create("twx.headless.mutex");
+        if (!hl->mutex) break;
+        hl->cond = hbs_cond_create(&ths, "twx.headless.cond");
+        if (!hl->cond)
+        {
+            if (ths != ZLX_MTH_NO_MEM) ts = TWX_MAIN_COND_INIT_FAILED;
+            break;
+        }
+        ts = tcond_create(&hl->frame_cond);
+        if (ts) break;
+        ts = headless_resize(hl, height, width);
+    }
+    while (0);
+
+    if (ts)
+    {
+        twx_headless_destroy(&hl->base);
+        return ts;
+    }
+    *be_ptr = &hl->base;
+    return TWX_OK;
+}
+
+/* twx_headless_destroy *****************************************************/
+TWX_API void ZLX_CALL twx_headless_destroy
+(
+    twx_backend_t * be
+)
+{
+    headless_t * hl = (headless_t *) be;
+
+    if (hl->cells) hbs_free(hl->cells, hl->cell_n * sizeof(headless_cell_t));
+    if (hl->frame_cond) tcond_destroy(hl->frame_cond);
+    if (hl->cond) hbs_cond_destroy(hl->cond);
+    if (hl->mutex) hbs_mutex_destroy(hl->mutex);
+    if (hl->q) hbs_free(hl->q, sizeof(acx1_event_t) * (hl->qm + 1));
+    hbs_free(hl, sizeof(headless_t));
+}
+
+/* twx_headless_push ********************************************************/
+TWX_API twx_status_t ZLX_CALL twx_headless_push
+(
+    twx_backend_t * be,
+    acx1_event_t const * e
+)
+{
+    headless_t * hl = (headless_t *) be;
+    twx_status_t ts = TWX_OK;
+
+    hbs_mutex_lock(hl->mutex);
+    do
+    {
+        if (hl->qe - hl->qb > hl->qm) { ts = TWX_QUEUE_FULL; break; }
+        if (e->type == ACX1_RESIZE)
+        {
+            if (!e->size.h || !e->size.w) { ts = TWX_BAD_SIZE; break; }
+            ts = headless_resize(hl, e->size.h, e->size.w);
+            if (ts) break;
+        }
+        hl->q[hl->qe++ & hl->qm] = *e;
+    }
+    while (0);
+    hbs_mutex_unlock(hl->mutex);
+    if (!ts) hbs_cond_signal(hl->cond);
+    return ts;
+}
+
+/* twx_headless_stats *******************************************************/
+TWX_API void ZLX_CALL twx_headless_stats
+(
+    twx_backend_t * be,
+    twx_headless_stats_t * total,
+    twx_headless_stats_t * last
+)
+{
+    headless_t * hl = (headless_t *) be;
+
+    hbs_mutex_lock(hl->mutex);
+    if (total) *total = hl->total;
+    if (last) *last = hl->last_frame;
+    hbs_mutex_unlock(hl->mutex);
+}
+
+/* twx_headless_wait ********************************************************/
+TWX_API uint64_t ZLX_CALL twx_headless_wait
+(
+    twx_backend_t * be,
+    uint64_t frames,
+    unsigned int usec
+)
+{
+    headless_t * hl = (headless_t *) be;
+    uint64_t at = clock_us() + usec, n;
+    int finished;
+
+    /* frame_cond is held while checking so that no signal gets lost */
+    tcond_lock(hl->frame_cond);
+    for (;;)
+    {
+        hbs_mutex_lock(hl->mutex);
+        n = hl->total.frames;
+        finished = hl->finished;
+        hbs_mutex_unlock(hl->mutex);
+        if (n >= frames || finished || clock_us() >= at) break;
+        tcond_wait(hl->frame_cond, at);
+    }
+    tcond_unlock(hl->frame_cond);
+    return n;
+}
+
+/* twx_headless_row *********************************************************/
+TWX_API size_t ZLX_CALL twx_headless_row
+(
+    twx_backend_t * be,
+    unsigned int row,
+    char * buf,
+    size_t size
+)
+{
+    headless_t * hl = (headless_t *) be;
+    headless_cell_t const * c;
+    size_t n = 0;
+    unsigned int i, l;
+    uint8_t u[4];
+
+    hbs_mutex_lock(hl->mutex);
+    if (row < hl->height)
+    {
+        c = hl->cells + (size_t) row * hl->width;
+        for (i = 0; i < hl->width; ++i)
+        {
+            if (!c[i].ch) continue;
+            l = zlx_ucp_to_utf8_len(c[i].ch);
+            zlxi_ucp_to_utf8(c[i].ch, u);
+            if (n + l < size) memcpy(buf + n, u, l);
+            else if (n < size) size = n + 1; // no partial chars
+            n += l;
+        }
+    }
+    hbs_mutex_unlock(hl->mutex);
+    if (size) buf[n < size ? n : size - 1] = 0;
+    return n;
+}
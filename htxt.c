@@ -1,9 +1,6 @@
 #include <string.h>
 #include "intern.h"
 
-twx_status_t ZLX_CALL htxt_handler (twx_win_t * win, unsigned int evt, 
-                                    twx_event_info_t * ei);
-
 twx_win_class_t htxt_wcls =
 {
     htxt_handler,
@@ -12,17 +9,497 @@ twx_win_class_t htxt_wcls =
     "txt/htxt"
 };
 
+/* htxt_row *****************************************************************/
+/**
+ *  Returns the row with the given index from the start of the content.
+ */
+ZLX_INLINE htxt_row_t * htxt_row (htxt_content_t * c, size_t i)
+{
+    return &c->ra[(c->r0 + i) & (c->rm - 1)];
+}
+
+/* htxt_chunk_drop *********************************************************/
+/**
+ *  Unlinks the oldest chunk once no row points into it; the chunk is kept
+ *  for reuse if it has the standard size and there are fewer spare ones
+ *  than TWX_HTXT_SPARE_CHUNKS with keep set, or none without.
+ *  The cap keeps a replaced content from doubling the memory held by the
+ *  window.
+ */
+static void htxt_chunk_drop (htxt_win_t * hw, htxt_content_t * c, int keep)
+{
+    htxt_chunk_t * k = c->ch_head;
+
+    c->ch_head = k->next;
+    if (!c->ch_head) c->ch_tail = NULL;
+    if (hw->ch_spare_n < (keep ? TWX_HTXT_SPARE_CHUNKS : 1)
+        && k->size == TWX_HTXT_CHUNK_SIZE)
+    {
+        k->next = hw->ch_spare;
+        k->used = k->live = 0;
+        hw->ch_spare = k;
+        hw->ch_spare_n++;
+    }
+    else hbs_free(k, k->size);
+}
+
+/* htxt_content_free ********************************************************/
+/**
+ *  Frees the rows of a content that is not published anymore, leaving its
+ *  by-reference buffer to the caller.
+ *  This resets the chunks holding row text instead of freeing rows one by
+ *  one; with keep set the chunks and the row ring are kept to be refilled,
+ *  otherwise the spare ones of the window are freed too.
+ */
+static void htxt_content_free (htxt_win_t * hw, htxt_content_t * c, int keep)
+{
+    htxt_chunk_t * k;
+
+    while (c->ch_head) htxt_chunk_drop(hw, c, keep);
+    if (keep && c->rm > hw->rm_spare)
+    {
+        if (hw->rm_spare)
+            hbs_free(hw->ra_spare, hw->rm_spare * sizeof(htxt_row_t));
+        hw->ra_spare = c->ra;
+        hw->rm_spare = c->rm;
+    }
+    else if (c->rm) hbs_free(c->ra, c->rm * sizeof(htxt_row_t));
+    c->rm = c->n = c->pend = 0;
+    if (keep) return;
+    while ((k = hw->ch_spare))
+    {
+        hw->ch_spare = k->next;
+        hbs_free(k, k->size);
+    }
+    hw->ch_spare_n = 0;
+    if (hw->rm_spare)
+        hbs_free(hw->ra_spare, hw->rm_spare * sizeof(htxt_row_t));
+    hw->rm_spare = 0;
+}
+
 /* htxt_finish **************************************************************/
 void ZLX_CALL htxt_finish (twx_win_t * win)
 {
     htxt_win_t * hw = (htxt_win_t *) win;
-    size_t i;
 
     hbs_mutex_destroy(hw->mutex);
-    for (i = 0; i < hw->rsn; ++i)
-        if (hw->rsa[i]) hbs_free(hw->rta[i], hw->rsa[i]);
-    if (hw->rsn) hbs_free(hw->rsa, hw->rsn * sizeof(size_t));
-    if (hw->rtn) hbs_free(hw->rta, hw->rtn * sizeof(uint8_t *));
+    hbs_mutex_destroy(hw->wmutex);
+    htxt_content_free(hw, &hw->c, 0);
+    if (hw->c.ref.release)
+        hw->c.ref.release(hw->c.ref.ctx, hw->c.ref.data, hw->c.ref.size);
+}
+
+/* htxt_draw_row ************************************************************/
+/**
+ *  Renders one row of hypertext into the frame buffer, padding it to the
+ *  right with attribute 0.
+ */
+static void htxt_draw_row (htxt_win_t * hw, unsigned int row,
+                           htxt_row_t const * r)
+{
+    twx_win_t * win = &hw->base;
+    acx1_attr_t const * attr = &hw->attr_a[0];
+    uint8_t const * t = r->t;
+    uint8_t const * end = t + r->l;
+    uint8_t const * e;
+    unsigned int n;
+
+    for (n = 0; t < end && n < win->width; t = e)
+    {
+        if (*t == '\a')
+        {
+            if (end - t < 2) break;
+            if (t[1] < hw->attr_n) attr = &hw->attr_a[t[1]];
+            e = t + 2;
+            continue;
+        }
+        for (e = t; e < end && *e != '\a'; ++e);
+        n += fb_write(win->twx, row, win->scr_col + n, win->width - n,
+                      t, e - t, attr);
+    }
+    if (n < win->width)
+        fb_fill(win->twx, row, win->scr_col + n, win->width - n, ' ',
+                &hw->attr_a[0]);
+}
+
+/* htxt_shift ***************************************************************/
+/**
+ *  Moves on screen the content of the window by the number of rows it was
+ *  scrolled since the last draw, then damages the rows exposed.
+ */
+static void htxt_shift (htxt_win_t * hw)
+{
+    twx_win_t * win = &hw->base;
+    ptrdiff_t s = hw->shift;
+    ptrdiff_t r0, r1;
+    size_t k = s > 0 ? (size_t) s : (size_t) -s;
+    unsigned int dr, dc, dh, dw;
+
+    hw->shift = 0;
+    if (k >= win->height)
+    {
+        twx_win_damage(win, win->scr_row, win->scr_col, 
+                       win->height, win->width);
+        return;
+    }
+    fb_scroll(win->twx, win->scr_row, win->scr_col, win->height, win->width, 
+              (int) s);
+
+    /* damage not drawn yet moves along with the content */
+    dr = win->dmg_row;
+    dc = win->dmg_col;
+    dh = win->dmg_height;
+    dw = win->dmg_width;
+    win->dmg_height = win->dmg_width = 0;
+    if (dh && dw)
+    {
+        r0 = (ptrdiff_t) dr - s;
+        r1 = r0 + dh;
+        if (r0 < (ptrdiff_t) win->scr_row) r0 = win->scr_row;
+        if (r1 > r0)
+            twx_win_damage(win, (unsigned int) r0, dc, 
+                           (unsigned int) (r1 - r0), dw);
+    }
+    twx_win_damage(win, s > 0 ? win->scr_row + win->height - (unsigned int) k
+                   : win->scr_row, win->scr_col, (unsigned int) k, win->width);
+}
+
+/* htxt_scroll_to ***********************************************************/
+/**
+ *  Changes the top row; must be called with the window mutex held.
+ *  Returns non-zero if the top row changed.
+ */
+static int htxt_scroll_to (htxt_win_t * hw, size_t top)
+{
+    size_t max = hw->c.n > hw->base.height ? hw->c.n - hw->base.height : 0;
+    if (top > max) top = max;
+    if (top == hw->top) return 0;
+    hw->shift += (ptrdiff_t) top - (ptrdiff_t) hw->top;
+    hw->top = top;
+    hw->base.flags |= TWX_WF_UPDATE;
+    return 1;
+}
+
+/* htxt_damage_rows *********************************************************/
+/**
+ *  Damages the on-screen area of rows [a, b); must be called with the
+ *  window mutex held.
+ *  The rows are placed where they were at the last draw because pending
+ *  damage is moved together with the content when the scroll is applied.
+ */
+static void htxt_damage_rows (htxt_win_t * hw, size_t a, size_t b)
+{
+    twx_win_t * win = &hw->base;
+    ptrdiff_t top = (ptrdiff_t) hw->top - hw->shift;
+    ptrdiff_t r0 = (ptrdiff_t) a - top;
+    ptrdiff_t r1 = (ptrdiff_t) b - top;
+
+    if (r0 < 0) r0 = 0;
+    if (r1 > (ptrdiff_t) win->height) r1 = win->height;
+    if (r0 >= r1) return;
+    twx_win_damage(win, win->scr_row + (unsigned int) r0, win->scr_col,
+                   (unsigned int) (r1 - r0), win->width);
+}
+
+/* htxt_chunk_alloc *********************************************************/
+/**
+ *  Returns room for l bytes of row text at the end of the newest chunk,
+ *  adding a chunk when the newest one is full.
+ */
+static uint8_t * htxt_chunk_alloc (htxt_win_t * hw, htxt_content_t * c,
+                                   size_t l)
+{
+    htxt_chunk_t * k = c->ch_tail;
+    size_t size;
+
+    if (!k || k->size - sizeof(htxt_chunk_t) - k->used < l)
+    {
+        size = sizeof(htxt_chunk_t) + l;
+        if (size <= TWX_HTXT_CHUNK_SIZE && hw->ch_spare)
+        {
+            k = hw->ch_spare;
+            hw->ch_spare = k->next;
+            hw->ch_spare_n--;
+            k->next = NULL;
+        }
+        else
+        {
+            /* rows longer than a chunk get one of their own */
+            if (size < TWX_HTXT_CHUNK_SIZE) size = TWX_HTXT_CHUNK_SIZE;
+            k = hbs_alloc(size, "twx.htxt.chunk");
+            if (!k) return NULL;
+            k->size = size;
+            k->used = k->live = 0;
+            k->next = NULL;
+        }
+        if (c->ch_tail) c->ch_tail->next = k;
+        else c->ch_head = k;
+        c->ch_tail = k;
+    }
+    k->live++;
+    k->used += l;
+    return k->data + k->used - l;
+}
+
+/* htxt_drop_text ***********************************************************/
+/**
+ *  Releases the chunk space taken by k rows that were dropped from the
+ *  start of the content, the first of them in ring slot r.
+ */
+static void htxt_drop_text (htxt_win_t * hw, htxt_content_t * c, size_t r,
+                            size_t k)
+{
+    htxt_chunk_t * ch;
+    htxt_row_t * row;
+    size_t i;
+
+    /* copied rows take chunk space in order, so the oldest ones are in the
+     * oldest chunk */
+    for (i = 0; i < k && (ch = c->ch_head); ++i)
+    {
+        row = &c->ra[(r + i) & (c->rm - 1)];
+        if (row->l && row->t >= ch->data && row->t < ch->data + ch->used
+            && !--ch->live)
+            htxt_chunk_drop(hw, c, 0);
+    }
+}
+
+/* htxt_view_drop ***********************************************************/
+/**
+ *  Keeps the view on the same rows after the oldest k rows were dropped;
+ *  must be called with the window mutex held.
+ *  The rows in view stay on screen unless the top row itself was dropped.
+ */
+static void htxt_view_drop (htxt_win_t * hw, size_t k)
+{
+    if (hw->top >= k) hw->top -= k;
+    else
+    {
+        hw->shift += (ptrdiff_t) (k - hw->top);
+        hw->top = 0;
+        hw->base.flags |= TWX_WF_UPDATE;
+    }
+}
+
+/* htxt_publish *************************************************************/
+/**
+ *  Makes the pending rows part of the content, dropping the oldest rows
+ *  beyond the row limit.
+ *  For the window content, the window mutex is held only while updating
+ *  the row counters and the view; the text of the dropped rows is released
+ *  after. A view showing the last row follows the new ones if the writer
+ *  asked for it.
+ *  Returns non-zero if the window needs drawing.
+ */
+static int htxt_publish (htxt_win_t * hw, htxt_content_t * c)
+{
+    size_t a, k, r;
+    int follow = 0, changed = 0;
+
+    if (c == &hw->c)
+    {
+        hbs_mutex_lock(hw->mutex);
+        follow = hw->follow && hw->top + hw->base.height >= c->n;
+    }
+    a = c->n;
+    c->n += c->pend;
+    c->pend = 0;
+    k = hw->max_rows && c->n > hw->max_rows ? c->n - hw->max_rows : 0;
+    r = c->r0;
+    if (k)
+    {
+        c->r0 = (c->r0 + k) & (c->rm - 1);
+        c->n -= k;
+    }
+    if (c == &hw->c)
+    {
+        if (k) htxt_view_drop(hw, k);
+        if (follow) htxt_scroll_to(hw, c->n);
+        htxt_damage_rows(hw, a > k ? a - k : 0, c->n);
+        changed = hw->base.flags & TWX_WF_UPDATE;
+        hbs_mutex_unlock(hw->mutex);
+    }
+    htxt_drop_text(hw, c, r, k);
+    return changed;
+}
+
+/* htxt_grow ****************************************************************/
+/**
+ *  Grows the row ring to at least n slots keeping the rows in order.
+ *  The ring of the window content is copied to the new one before taking
+ *  the window mutex, which is held only for switching to it.
+ */
+static twx_status_t htxt_grow (htxt_win_t * hw, htxt_content_t * c, size_t n)
+{
+    htxt_row_t * ra;
+    htxt_row_t * old = c->ra;
+    size_t om = c->rm;
+    size_t m = om ? om : 16;
+    size_t k = c->n + c->pend;
+    size_t j;
+
+    while (m < n) m <<= 1;
+    if (m <= om) return TWX_OK;
+
+    if (c != &hw->c)
+    {
+        /* nobody draws a content being built: resize it in place */
+        ra = hbs_realloc(old, om * sizeof(htxt_row_t), m * sizeof(htxt_row_t));
+        if (!ra) return TWX_NO_MEM;
+        /* the rows that wrapped around go right after the old end */
+        if (c->r0 + k > om)
+            memcpy(ra + om, ra, (c->r0 + k - om) * sizeof(htxt_row_t));
+        c->ra = ra;
+        c->rm = m;
+        return TWX_OK;
+    }
+
+    ra = hbs_alloc(m * sizeof(htxt_row_t), "twx.htxt.rows");
+    if (!ra) return TWX_NO_MEM;
+    if (k)
+    {
+        /* the rows that wrapped around go right after the others */
+        j = om - c->r0 < k ? om - c->r0 : k;
+        memcpy(ra, old + c->r0, j * sizeof(htxt_row_t));
+        memcpy(ra + j, old, (k - j) * sizeof(htxt_row_t));
+    }
+    if (c == &hw->c) hbs_mutex_lock(hw->mutex);
+    c->ra = ra;
+    c->rm = m;
+    c->r0 = 0;
+    if (c == &hw->c) hbs_mutex_unlock(hw->mutex);
+    if (om) hbs_free(old, om * sizeof(htxt_row_t));
+    return TWX_OK;
+}
+
+/* htxt_new_row *************************************************************/
+/**
+ *  Returns the slot for a row added after the pending ones. When the ring
+ *  is full the pending rows are published if that drops old rows, else the
+ *  ring is grown.
+ *  The caller fills in the row then increments the pending count.
+ */
+static htxt_row_t * htxt_new_row (htxt_win_t * hw, htxt_content_t * c)
+{
+    size_t k = c->n + c->pend;
+
+    if (k == c->rm)
+    {
+        if (hw->max_rows && k > hw->max_rows)
+        {
+            htxt_publish(hw, c);
+            k = c->n;
+        }
+        if (k == c->rm && htxt_grow(hw, c, k + 1)) return NULL;
+    }
+    return htxt_row(c, k);
+}
+
+/* htxt_copy_row ************************************************************/
+/**
+ *  Adds a copy of [p, p + l) as a pending row.
+ */
+static twx_status_t htxt_copy_row (htxt_win_t * hw, htxt_content_t * c,
+                                   uint8_t const * p, size_t l)
+{
+    htxt_row_t * r;
+    uint8_t * b = NULL;
+
+    r = htxt_new_row(hw, c);
+    if (!r) return TWX_NO_MEM;
+    if (l)
+    {
+        b = htxt_chunk_alloc(hw, c, l);
+        if (!b) return TWX_NO_MEM;
+        memcpy(b, p, l);
+    }
+    r->t = b;
+    r->l = l;
+    c->pend++;
+    return TWX_OK;
+}
+
+/* htxt_add_text ************************************************************/
+/**
+ *  Adds a copy of each line of a NUL-terminated hypertext as pending rows.
+ *  The text is scanned once, stopping only at '\n', '\a' and NUL.
+ *  If trim is set, empty lines at the end are dropped; otherwise only the
+ *  new line terminating the last line is.
+ */
+static twx_status_t htxt_add_text (htxt_win_t * hw, htxt_content_t * c,
+                                   uint8_t const * p, int trim)
+{
+    uint8_t const * s;
+    size_t blank = 0;
+    twx_status_t ts;
+
+    for (s = p;; s = ++p)
+    {
+        for (;;)
+        {
+            p = scan_ctl(p);
+            if (*p != '\a') break;
+            p += 2; // the attribute byte may be anything, even NUL
+        }
+        if (p == s && trim)
+        {
+            /* kept only if some text follows */
+            blank += *p != 0;
+            if (!*p) break;
+            continue;
+        }
+        for (; blank; --blank)
+            if ((ts = htxt_copy_row(hw, c, s, 0))) return ts;
+        if ((p != s || *p) && (ts = htxt_copy_row(hw, c, s, p - s)))
+            return ts;
+        if (!*p) break;
+    }
+    return TWX_OK;
+}
+
+/* htxt_ref_eol *************************************************************/
+/**
+ *  Returns the '\n' ending the row that starts at p, or e; like in copied
+ *  text, a '\n' that is the attribute byte of a '\a' escape is skipped.
+ */
+static uint8_t const * htxt_ref_eol (uint8_t const * p, uint8_t const * e)
+{
+    uint8_t const * q;
+
+    for (q = scan_nl(p, e); q < e && htxt_nl_attr(p, q); q = scan_nl(q + 1, e));
+    return q;
+}
+
+/* htxt_add_ref_rows ********************************************************/
+/**
+ *  Adds pending rows pointing to each line in [p, e) without copying the
+ *  text.
+ */
+static twx_status_t htxt_add_ref_rows (htxt_win_t * hw, htxt_content_t * c,
+                                       uint8_t const * p, uint8_t const * e)
+{
+    htxt_row_t * r;
+    uint8_t const * q;
+    size_t n;
+    twx_status_t ts;
+
+    /* size the ring once instead of doubling it along the way */
+    for (n = 0, q = p; q < e; ++n, ++q) q = htxt_ref_eol(q, e);
+    n += c->n + c->pend;
+    if (hw->max_rows && n > hw->max_rows) n = hw->max_rows;
+    ts = htxt_grow(hw, c, n);
+    if (ts) return ts;
+
+    for (; p < e; p = q + 1)
+    {
+        q = htxt_ref_eol(p, e);
+        r = htxt_new_row(hw, c);
+        if (!r) return TWX_NO_MEM;
+        r->t = p;
+        r->l = q - p;
+        c->pend++;
+    }
+    return TWX_OK;
 }
 
 /* htxt_handler *************************************************************/
@@ -30,9 +507,9 @@ twx_status_t ZLX_CALL htxt_handler (twx_win_t * win, unsigned int evt,
                                     twx_event_info_t * ei)
 {
     htxt_win_t * hw = (htxt_win_t *) win;
-    size_t n;
+    size_t i, n;
+    unsigned int top, bottom;
     twx_status_t ts = TWX_OK;
-    unsigned int cs;
 
     switch (evt)
     {
@@ -43,23 +520,36 @@ twx_status_t ZLX_CALL htxt_handler (twx_win_t * win, unsigned int evt,
                    win->wcls->name, win->id);
             break;
         }
-        win->flags &= ~TWX_WF_UPDATE;
         hbs_mutex_lock(hw->mutex);
-        n = hw->n;
-        HBS_DM("rect $i+$i+$ix$i $es...", win->scr_col, win->scr_row, win->width, n, hw->rta[0]);
-        if (win->height < n) n = win->height;
-        O(acx1_rect((uint8_t const * const *) hw->rta,
-                    win->scr_row, win->scr_col, n, win->width, hw->attr_a));
-        for (;n < win->height; ++n)
-        {
-            O(acx1_write_pos(win->scr_row + n, win->scr_col));
-            O(acx1_attr(hw->attr_a[0].bg, hw->attr_a[0].fg, 
-                        hw->attr_a[0].mode));
-            O(acx1_fill(' ', win->width));
-        }
+        if (hw->shift) htxt_shift(hw);
+        win_draw_begin(win, &top, &bottom);
+        n = hw->c.n > hw->top ? hw->c.n - hw->top : 0;
+        HBS_DM("rows $i..$i of $i+$i+$ix$i", top, bottom,
+               win->scr_col, win->scr_row, win->width, win->height);
+        if (bottom < n) n = bottom;
+        for (i = top; i < n; ++i)
+            htxt_draw_row(hw, win->scr_row + i, htxt_row(&hw->c, hw->top + i));
+        for (; i < bottom; ++i)
+            fb_fill(win->twx, win->scr_row + i, win->scr_col, win->width, ' ',
+                    &hw->attr_a[0]);
+        win_draw_end(win);
         hbs_mutex_unlock(hw->mutex);
         HBS_DM("finished drawing $s@$i", win->wcls->name, win->id);
         break;
+    case TWX_GEOM:
+        hbs_mutex_lock(hw->mutex);
+        hw->shift = 0;
+        ts = twx_default_handler(win, evt, ei);
+        htxt_scroll_to(hw, hw->top);
+        hw->shift = 0;
+        hbs_mutex_unlock(hw->mutex);
+        break;
+    case TWX_INVALIDATE:
+        /* damage is also recorded by the threads appending content */
+        hbs_mutex_lock(hw->mutex);
+        ts = twx_default_handler(win, evt, ei);
+        hbs_mutex_unlock(hw->mutex);
+        break;
     default:
         ts = twx_default_handler(win, evt, ei);
     }
@@ -67,6 +557,60 @@ twx_status_t ZLX_CALL htxt_handler (twx_win_t * win, unsigned int evt,
     return ts;
 }
 
+/* htxt_init ****************************************************************/
+twx_status_t htxt_init (htxt_win_t * hw, acx1_attr_t * attr_a, size_t attr_n)
+{
+    hw->mutex = hbs_mutex_create("twx.htxt.mutex");
+    L("mutex=%p", hw->mutex);
+    if (!hw->mutex) return TWX_NO_MEM;
+    hw->wmutex = hbs_mutex_create("twx.htxt.wmutex");
+    if (!hw->wmutex)
+    {
+        hbs_mutex_destroy(hw->mutex);
+        hw->mutex = NULL;
+        return TWX_NO_MEM;
+    }
+    hw->attr_a = attr_a;
+    hw->attr_n = attr_n;
+    return TWX_OK;
+}
+
+/* htxt_append_ref **********************************************************/
+twx_status_t htxt_append_ref (htxt_win_t * hw, uint8_t const * p,
+                              uint8_t const * e)
+{
+    int changed;
+    twx_status_t ts;
+
+    hbs_mutex_lock(hw->wmutex);
+    ts = htxt_add_ref_rows(hw, &hw->c, p, e);
+    changed = htxt_publish(hw, &hw->c);
+    hbs_mutex_unlock(hw->wmutex);
+    if (changed) twx_refresh(hw->base.twx);
+    return ts;
+}
+
+/* htxt_swap ****************************************************************/
+/**
+ *  Publishes a content built aside in place of the current one and frees
+ *  the latter; must be called with the writer mutex held.
+ *  The window mutex is held only for the swap. The by-reference buffer of
+ *  the old content is returned for the caller to release once unlocked.
+ */
+static htxt_ref_t htxt_swap (htxt_win_t * hw, htxt_content_t * c, int keep)
+{
+    htxt_content_t old;
+
+    hbs_mutex_lock(hw->mutex);
+    old = hw->c;
+    hw->c = *c;
+    htxt_scroll_to(hw, hw->top);
+    hw->shift = 0;
+    hbs_mutex_unlock(hw->mutex);
+    htxt_content_free(hw, &old, keep);
+    return old.ref;
+}
+
 /* twx_htxt_win_create ******************************************************/
 TWX_API twx_status_t ZLX_CALL twx_htxt_win_create
 (
@@ -83,12 +627,12 @@ TWX_API twx_status_t ZLX_CALL twx_htxt_win_create
     hw = win_alloc(twx, &htxt_wcls);
     L("hw=%p", hw);
     if (!hw) return TWX_NO_MEM;
-    hw->mutex = hbs_mutex_create("twx.htxt.mutex");
-    L("mutex=%p", hw->mutex);
-    if (!hw->mutex) { hbs_free(hw, htxt_wcls.size); return TWX_NO_MEM; }
+    if (htxt_init(hw, attr_a, attr_n))
+    {
+        hbs_free(hw, htxt_wcls.size);
+        return TWX_NO_MEM;
+    }
     *win_ptr = &hw->base;
-    hw->attr_a = attr_a;
-    hw->attr_n = attr_n;
     L("setting content...");
     twx_htxt_win_set_content(&hw->base, htxt);
     L("set content done");
@@ -103,74 +647,134 @@ TWX_API twx_status_t ZLX_CALL twx_htxt_win_set_content
 )
 {
     htxt_win_t * hw = (htxt_win_t *) win;
-    size_t i, n, nn, l;
-    uint8_t const * p;
-    uint8_t const * q;
-    uint8_t const * e;
-    uint8_t * * rta;
-    size_t * rsa;
+    htxt_content_t c;
+    htxt_ref_t old;
     twx_status_t ts;
 
-    hbs_mutex_lock(hw->mutex);
-    p = htxt;
-    for (e = p; *e; e += 1 + (*e == '\a'));
-    //e = zlx_u8a_scan(p, 0);
+    /* the new rows are parsed and copied with drawing going on; only
+     * switching to them waits for the frame being drawn */
+    memset(&c, 0, sizeof(c));
+    hbs_mutex_lock(hw->wmutex);
+    c.ra = hw->ra_spare;
+    c.rm = hw->rm_spare;
+    hw->rm_spare = 0;
+    ts = htxt_add_text(hw, &c, htxt, 1);
+    htxt_publish(hw, &c);
+    L("n=%u, rm=%u\n", (int) c.n, (int) c.rm);
+    old = htxt_swap(hw, &c, 1);
+    hbs_mutex_unlock(hw->wmutex);
+    if (old.release) old.release(old.ctx, old.data, old.size);
+    return ts;
+}
 
-    L("e - p = %ld\n", (long) (e - p));
-    do
-    {
-        while (p != e && e[-1] == '\n') --e;
-        n = 0;
-        for (n = 0; p < e; ++n, ++p) {
-            p = zlx_u8a_search(p, e, '\n');
-        }
-        L("n=%u\n", (int) n);
-
-        ts = TWX_NO_MEM;
-        if (hw->rtn < n) {
-            nn = (n + 3) & ~(size_t) 3;
-            rta = hbs_realloc(hw->rta,
-                              hw->rtn * sizeof(uint8_t *),
-                              nn * sizeof(uint8_t *));
-            if (!rta) break;
-            for (i = hw->rtn; i < nn; ++i) rta[i] = NULL;
-            hw->rta = rta;
-            hw->rtn = nn;
-        }
-        if (hw->rsn < n) {
-            nn = (n + 3) & ~(size_t) 3;
-            rsa = hbs_realloc(hw->rsa,
-                              hw->rsn * sizeof(size_t),
-                              nn * sizeof(size_t));
-            if (!rsa) break;
-            for (i = hw->rsn; i < nn; ++i) rsa[i] = 0;
-            hw->rsa = rsa;
-            hw->rsn = nn;
-        }
-        L("rtn=%u, rsn=%u\n", (int) hw->rtn, (int) hw->rsn);
+/* twx_htxt_win_set_content_ref *********************************************/
+TWX_API twx_status_t ZLX_CALL twx_htxt_win_set_content_ref
+(
+    twx_win_t * win,
+    void const * htxt,
+    size_t size,
+    twx_htxt_release_f release,
+    void * ctx
+)
+{
+    htxt_win_t * hw = (htxt_win_t *) win;
+    htxt_content_t c;
+    htxt_ref_t old;
+    uint8_t const * p = htxt;
+    uint8_t const * e = p + size;
+    twx_status_t ts;
 
-        for (p = htxt, i = 0; i < n && p < e; ++i, p = q + 1)
-        {
-            q = zlx_u8a_search(p, e, '\n');
-            l = q - p + 1;
-            if (hw->rsa[i] < l)
-            {
-                l = (l + 15) & ~(size_t) 15;
-                if (hw->rsa[i]) hbs_free(hw->rta[i], hw->rsa[i]);
-                hw->rta[i] = hbs_alloc(l, "twx.htxt.row");
-                if (!hw->rta[i]) { hw->rsa[i] = 0; break; }
-                hw->rsa[i] = l;
-            }
-            memcpy(hw->rta[i], p, q - p);
-            hw->rta[i][q - p] = 0;
-        }
-        hw->n = i;
-        if (i < n) break;
-        ts = TWX_OK;
-    }
-    while (0);
+    while (p != e && e[-1] == '\n') --e;
+    memset(&c, 0, sizeof(c));
+    hbs_mutex_lock(hw->wmutex);
+    ts = htxt_add_ref_rows(hw, &c, p, e);
+    if (ts) c.pend = 0;
+    htxt_publish(hw, &c);
+    L("n=%u, rm=%u\n", (int) c.n, (int) c.rm);
+    c.ref.data = htxt;
+    c.ref.size = size;
+    c.ref.release = release;
+    c.ref.ctx = ctx;
+    old = htxt_swap(hw, &c, 0);
+    hbs_mutex_unlock(hw->wmutex);
+    if (old.release) old.release(old.ctx, old.data, old.size);
+    return ts;
+}
 
-    hbs_mutex_unlock(hw->mutex);
+/* twx_htxt_win_append ******************************************************/
+TWX_API twx_status_t ZLX_CALL twx_htxt_win_append
+(
+    twx_win_t * win,
+    void const * htxt
+)
+{
+    htxt_win_t * hw = (htxt_win_t *) win;
+    int changed;
+    twx_status_t ts;
+
+    if (!*(uint8_t const *) htxt) return TWX_OK;
+
+    hbs_mutex_lock(hw->wmutex);
+    /* a window showing the last row keeps following the new ones */
+    hw->follow = 1;
+    ts = htxt_add_text(hw, &hw->c, htxt, 0);
+    changed = htxt_publish(hw, &hw->c);
+    hw->follow = 0;
+    hbs_mutex_unlock(hw->wmutex);
+    if (changed) twx_refresh(win->twx);
     return ts;
 }
 
+/* twx_htxt_win_set_max_rows ************************************************/
+TWX_API twx_status_t ZLX_CALL twx_htxt_win_set_max_rows
+(
+    twx_win_t * win,
+    size_t max_rows
+)
+{
+    htxt_win_t * hw = (htxt_win_t *) win;
+    int changed;
+
+    hbs_mutex_lock(hw->wmutex);
+    hw->max_rows = max_rows;
+    /* publishing nothing drops the rows beyond the new limit */
+    changed = htxt_publish(hw, &hw->c);
+    hbs_mutex_unlock(hw->wmutex);
+    if (changed) twx_refresh(win->twx);
+    return TWX_OK;
+}
+
+/* twx_htxt_win_set_top *****************************************************/
+TWX_API twx_status_t ZLX_CALL twx_htxt_win_set_top
+(
+    twx_win_t * win,
+    size_t top
+)
+{
+    htxt_win_t * hw = (htxt_win_t *) win;
+    int changed;
+
+    hbs_mutex_lock(hw->mutex);
+    changed = htxt_scroll_to(hw, top);
+    hbs_mutex_unlock(hw->mutex);
+    if (changed) twx_refresh(win->twx);
+    return TWX_OK;
+}
+
+/* twx_htxt_win_scroll ******************************************************/
+TWX_API twx_status_t ZLX_CALL twx_htxt_win_scroll
+(
+    twx_win_t * win,
+    ptrdiff_t delta
+)
+{
+    htxt_win_t * hw = (htxt_win_t *) win;
+    int changed;
+
+    hbs_mutex_lock(hw->mutex);
+    changed = htxt_scroll_to(hw, delta < 0 && (size_t) -delta > hw->top
+                             ? 0 : hw->top + delta);
+    hbs_mutex_unlock(hw->mutex);
+    if (changed) twx_refresh(win->twx);
+    return TWX_OK;
+}
@@ -7,10 +7,67 @@
 #include "twx.h"
 
 #define TWX_KEY_RING_POWER 8
+#define TWX_KEY_RING_WAIT_US 1000 // nap of the input thread on a full ring
+#define TWX_POST_RING_POWER 10 // slots for events posted by other threads
+#define TWX_POST_BATCH 64 // posted events handled before checking input
+#define TWX_FRAME_INTERVAL_DEFAULT 16667 // microseconds (60 frames/second)
+#define TWX_FB_SCROLL_MAX 4 // terminal scroll ops queued between flushes
+#define TWX_HTXT_CHUNK_SIZE 0x10000 // bytes per chunk of copied row text
+#define TWX_HTXT_SPARE_CHUNKS 4 // chunks of a replaced content kept for reuse
+#define TWX_OUT_SIZE 0x4000 // initial size of the frame output buffer
+
+#define TWX_CURSOR_UNKNOWN 2 // out_cursor_mode before it is first set
+#define TWX_TRACE_RING_POWER 13 // trace records kept per traced thread
+#define TWX_TIMER_TICK_US 1000 // resolution of timers
+#define TWX_TIMER_BITS 6 // log2 of the slots in a level of the timer wheel
+#define TWX_TIMER_LEVELS 4 // timer wheel levels; they reach 2^24 ticks
+
+/* the trace ring is compiled in for checked and debug builds; build with
+ * TWX_TRACE=1 to have it in release builds too */
+#ifndef TWX_TRACE
+#if _CHECKED || _DEBUG
+#define TWX_TRACE 1
+#else
+#define TWX_TRACE 0
+#endif
+#endif
+
+/* thread-local storage, to tell the thread running twx_run() */
+#if defined(_MSC_VER)
+#define TWX_TLS __declspec(thread)
+#else
+#define TWX_TLS __thread
+#endif
+
+/* pastes can only be bracketed if acx1 reports the start and end markers */
+#if defined(ACX1_PASTE_BEGIN) && defined(ACX1_PASTE_END)
+#define TWX_BRACKETED_PASTE 1
+#else
+#define TWX_BRACKETED_PASTE 0
+#endif
+
+/* key ring entry standing for the next paste in twx_t.paste_head */
+#define TWX_KEY_PASTE 0xFFFFFFFF
 
 typedef struct blank_win_s blank_win_t;
 typedef struct htxt_win_s htxt_win_t;
+typedef struct htxt_row_s htxt_row_t;
+typedef struct htxt_chunk_s htxt_chunk_t;
+typedef struct htxt_ref_s htxt_ref_t;
+typedef struct htxt_content_s htxt_content_t;
+typedef struct fview_win_s fview_win_t;
 typedef struct itxt_win_s itxt_win_t;
+typedef struct split_child_s split_child_t;
+typedef struct split_win_s split_win_t;
+typedef struct twx_cell_s twx_cell_t;
+typedef struct fb_scroll_s fb_scroll_t;
+typedef struct twx_paste_s twx_paste_t;
+typedef struct twx_post_s twx_post_t;
+typedef struct trace_rec_s trace_rec_t;
+typedef struct timer_link_s timer_link_t;
+typedef struct twx_timer_s twx_timer_t;
+typedef struct trace_ring_s trace_ring_t;
+typedef struct twx_tcond_s twx_tcond_t;
 
 enum twx_state_enum
 {
@@ -22,29 +79,200 @@ enum twx_state_enum
 };
 
 #define TWX_INITED_CONSOLE (1 << 0)
-#define TWX_INITED_MUTEX (1 << 1)
-#define TWX_INITED_COND (1 << 2)
-#define TWX_INITED_INPUT (1 << 3)
-#define TWX_INITED_KEY_RING (1 << 4)
+#define TWX_INITED_MAIN (1 << 1)
+#define TWX_INITED_INPUT (1 << 2)
+#define TWX_INITED_KEY_RING (1 << 3)
+
+/* twx_cell_s ***************************************************************/
+/**
+ *  One screen cell of the frame buffer.
+ *  A double-width char occupies 2 cells: the lead cell with w = 2 followed
+ *  by a continuation cell with w = 0 and ch = 0.
+ */
+struct twx_cell_s
+{
+    uint32_t ch; // code point
+    uint32_t cm; // zero-width code point combined with ch (0 if none)
+    uint8_t w; // display width
+    uint8_t bg, fg, mode;
+};
+
+/* fb_scroll_s **************************************************************/
+/**
+ *  Scroll of whole screen rows [top, bottom) by n rows (up if n > 0)
+ *  already applied to both grids and still to be sent to the terminal.
+ */
+struct fb_scroll_s
+{
+    unsigned int top, bottom;
+    int n;
+};
+
+/* twx_paste_s **************************************************************/
+/**
+ *  Text of one bracketed paste, collected by input_processor() and queued
+ *  for twx_run().
+ */
+struct twx_paste_s
+{
+    twx_paste_t * next;
+    size_t size; // bytes used in data
+    size_t alloc; // bytes allocated for data
+    uint8_t data[];
+};
+
+/* timer_link_s *************************************************************/
+struct timer_link_s
+{
+    timer_link_t * next;
+    timer_link_t * prev;
+};
+
+/* twx_timer_s **************************************************************/
+/**
+ *  Timer started with twx_timer_start(), kept in a slot of the timer wheel
+ *  or in twx_t.timer_fire while being delivered, and in the list of timers
+ *  of its window.
+ */
+struct twx_timer_s
+{
+    timer_link_t link;
+    twx_win_t * win;
+    twx_timer_t * wnext; // next timer of the window
+    twx_timer_t * * wprev; // link pointing to this timer in that list
+    uint64_t due; // clock_us() when it fires next
+    unsigned int interval; // microseconds
+    unsigned int id;
+    uint16_t slot; // level << TWX_TIMER_BITS | slot in the level
+};
+
+/* trace_thread_enum ********************************************************/
+/**
+ *  Threads with a trace ring; each ring has a single writer.
+ */
+enum trace_thread_enum
+{
+    TRACE_MAIN, // twx_run()
+    TRACE_INPUT, // input_processor()
+    TRACE_THREADS
+};
+
+/* trace_kind_enum **********************************************************/
+enum trace_kind_enum
+{
+    TRACE_HANDLER, // span of a handler call; p: window class, arg: event
+    TRACE_FRAME, // span from out_begin() to out_end()
+    TRACE_READ_EVENT, // span of reading and queueing an input event
+    TRACE_KEY_IN, // key queued; arg: key, id: key number
+    TRACE_KEY_OUT, // key taken from the ring for a handler; id: key number
+};
+
+/* trace_rec_s **************************************************************/
+struct trace_rec_s
+{
+    uint64_t t0, t1; // clock_ns() at the start and end of the span
+    void const * p;
+    uint32_t arg;
+    uint32_t id;
+    uint8_t kind;
+};
+
+/* trace_ring_s *************************************************************/
+/**
+ *  The writer fills the record at n and then publishes it by storing n + 1;
+ *  readers drop the records that may have been overwritten while copied.
+ */
+struct trace_ring_s
+{
+    trace_rec_t * a;
+    size_t n; // records written since creation
+};
+
+/* twx_post_s ***************************************************************/
+/**
+ *  Slot of the posted event ring. seq tells the slot state for the ring
+ *  position pos it maps to: pos when free, pos + 1 when holding an event
+ *  and pos + ring size once consumed, free for the next lap.
+ */
+struct twx_post_s
+{
+    size_t seq;
+    twx_win_t * win;
+    unsigned int evt;
+    twx_event_info_t ei;
+};
 
 struct twx_s
 {
-    zlx_mutex_t * main_mutex;
+    twx_backend_t * be;
+    twx_tcond_t * main; // guards the state shared with twx_run(), which
+    // waits on it with the deadline of the next frame or timer
     zlx_tid_t input_thread;
-    zlx_cond_t * main_cond;
     twx_win_t * root_win;
     twx_win_t * focus_win;
     twx_win_t * new_focus_win;
-    uint32_t * key_ring;
+    uint32_t * key_ring; // single-producer/single-consumer ring
+    twx_paste_t * paste_head; // pastes with a TWX_KEY_PASTE in the key
+    twx_paste_t * paste_tail; // ring, oldest first; guarded by main
+    twx_post_t * post_ring; // multi-producer/single-consumer ring
+    size_t prb; // post ring begin; written only by twx_run()
+    size_t pre; // post ring end; claimed by producers with compare-exchange
+    size_t prm;
     twx_status_t exit_status;
-    unsigned int krb, kre, krm;
+    unsigned int krb; // key ring begin; written only by twx_run()
+    unsigned int kre; // key ring end; written only by input_processor()
+    unsigned int krm;
+    uint64_t frame_us; // when the last frame was drawn
+    unsigned int frame_interval; // minimum microseconds between frames
     unsigned int height, width;
     unsigned int seed;
+    twx_cell_t * fb_back; // cells rendered by windows for the next frame
+    twx_cell_t * fb_front; // cells as they are currently on the terminal
+    size_t fb_size; // number of cells allocated for each of the grids
+    unsigned int fb_height, fb_width;
+    unsigned int fb_dirty_top, fb_dirty_end; // back rows changed since flush
+    unsigned int clip_top, clip_bottom; // 0-based rows where drawing lands
+    unsigned int clip_left, clip_right; // 0-based cols where drawing lands
+    fb_scroll_t fb_scroll_a[TWX_FB_SCROLL_MAX];
+    unsigned int fb_scroll_n;
+    unsigned int caps; // TWX_CAP_xxx of the backend
+    twx_stats_t stats;
+    twx_win_class_t * stats_cls[TWX_STATS_CLASSES]; // classes in stats
+    uint64_t nested_ns; // time in handlers called by the running handler
+    /* timer wheel: a timer due at tick t (in TWX_TIMER_TICK_US) sits on
+     * the lowest level l where t and timer_tick differ by less than
+     * 2^TWX_TIMER_BITS in their bits above l * TWX_TIMER_BITS; slot l
+     * timers move down a level when timer_tick reaches their block */
+    timer_link_t timer_slot[TWX_TIMER_LEVELS][1 << TWX_TIMER_BITS];
+    uint64_t timer_map[TWX_TIMER_LEVELS]; // non-empty slots
+    uint64_t timer_tick; // tick the wheel got to
+    timer_link_t timer_fire; // expired timers being delivered
+    size_t timer_n; // timers started
+#if TWX_TRACE
+    trace_ring_t trace_a[TRACE_THREADS];
+    uint32_t trace_key_in; // keys queued; written by input_processor()
+    uint32_t trace_key_out; // keys taken; written by twx_run()
+    uint64_t trace_frame_t0; // when the frame being sent started
+#endif
+    unsigned int cursor_row, cursor_col; // cursor pos requested by windows
+    unsigned int out_row, out_col; // 1-based terminal cursor position;
+    // out_row is 0 when unknown and out_col is past the last column when
+    // the cursor waits there after writing in the last column
+    twx_cell_t out_pen; // attribute last sent to the terminal
+    uint8_t * out_a; // output of the frame not yet given to the backend
+    size_t out_n; // bytes in out_a
+    size_t out_m; // allocated size of out_a
     uint8_t state;
     volatile uint8_t shutdown;
     uint8_t screen_resized;
     uint8_t draw_mode;
+    uint8_t draw_now; // draw without waiting for the frame interval
     uint8_t init_state;
+    uint8_t main_waiting; // twx_run() is about to wait on main
+    uint8_t out_pen_valid;
+    uint8_t out_cursor_mode; // last cursor mode set or TWX_CURSOR_UNKNOWN
+    uint8_t out_frame; // between out_begin() and out_end()
+    uint8_t fb_clear; // terminal needs clearing before the next flush
 };
 
 struct blank_win_s
@@ -54,17 +282,65 @@ struct blank_win_s
     uint32_t ch;
 };
 
+struct htxt_row_s
+{
+    uint8_t const * t; // row text (not NUL-terminated); points into a
+    // chunk of the window or into the by-reference buffer
+    size_t l; // length of the row text
+};
+
+struct htxt_chunk_s
+{
+    htxt_chunk_t * next; // newer chunk
+    size_t size; // bytes allocated, including this header
+    size_t used; // bytes of data taken by rows
+    size_t live; // rows still pointing into the chunk
+    uint8_t data[];
+};
+
+struct htxt_ref_s
+{
+    void const * data; // caller buffer rows may point into
+    size_t size;
+    twx_htxt_release_f release;
+    void * ctx;
+};
+
+/* htxt_content_s ***********************************************************/
+/**
+ *  Rows of a hypertext window and the memory their text lives in.
+ *  Rows are added past the n published ones, where drawing never looks,
+ *  and become visible when n is bumped with the window mutex held.
+ */
+struct htxt_content_s
+{
+    htxt_row_t * ra; // row ring buffer
+    size_t rm; // number of slots in the ring (power of 2)
+    size_t r0; // slot holding the first row
+    size_t n; // number of published rows
+    size_t pend; // rows filled in after the published ones
+    htxt_chunk_t * ch_head; // oldest chunk holding copied row text
+    htxt_chunk_t * ch_tail; // chunk new rows are copied to
+    htxt_ref_t ref; // buffer set with twx_htxt_win_set_content_ref()
+};
+
 struct htxt_win_s
 {
     twx_win_t base;
-    zlx_mutex_t * mutex;
-    uint8_t * * rta; // row text array
-    size_t * rsa; // row len array - how many bytes are allocated for each row
+    zlx_mutex_t * mutex; // guards what drawing reads: the ring and the view
+    zlx_mutex_t * wmutex; // serializes the threads changing the content
+    htxt_content_t c;
     acx1_attr_t * attr_a;
     size_t attr_n;
-    size_t rtn; // number of rows in row text array
-    size_t rsn; // number of rows in row size array
-    size_t n; // number of used rows
+    size_t max_rows; // oldest rows are dropped beyond this; 0 = no limit
+    htxt_chunk_t * ch_spare; // emptied chunks kept for reuse
+    size_t ch_spare_n; // number of chunks in ch_spare
+    htxt_row_t * ra_spare; // row ring of a replaced content kept for reuse
+    size_t rm_spare; // number of slots in ra_spare
+    int follow; // the rows being added are followed by a view showing the
+    // last row; set by writers
+    size_t top; // index of the row displayed at the top of the window
+    ptrdiff_t shift; // rows scrolled since last draw (positive = up)
 };
 
 struct itxt_win_s
@@ -73,12 +349,12 @@ struct itxt_win_s
     zlx_mutex_t * mutex;
     acx1_attr_t * attr_a;
     uint8_t * pfx;
-    uint8_t * text;
+    uint8_t * text; // gap buffer with the gap at cursor_ofs
     size_t attr_n;
     size_t pfx_size; // allocated size
     size_t pfx_width;
-    size_t text_n;
-    size_t text_size;
+    size_t text_n; // bytes of text, not counting the gap
+    size_t text_size; // allocated size
     size_t view_ofs; // offset in text where to start displaying
     size_t cursor_ofs; // offset in text where the cursor is pointing to
     size_t cursor_col; // column where the cursor is (relative to view text)
@@ -88,6 +364,42 @@ struct itxt_win_s
     unsigned int ntf_id;
 };
 
+struct fview_win_s
+{
+    htxt_win_t htxt;
+    twx_win_t * ntf_win;
+    unsigned int ntf_id;
+    uint8_t const * data; // mapped file
+    size_t size;
+    size_t indexed; // bytes turned into rows so far; set by the index thread
+#if _WIN32
+    void * map; // file mapping handle
+#endif
+    zlx_tid_t index_thread;
+    uint8_t cancel; // tells the index thread to stop
+    uint8_t thread_started;
+};
+
+struct split_child_s
+{
+    twx_win_t * win;
+    unsigned int size; // minimum cells along the split axis
+    unsigned int weight; // share of the space left after minimum sizes
+    unsigned int pos, len; // cached layout along the split axis
+};
+
+struct split_win_s
+{
+    twx_win_t base;
+    acx1_attr_t * attr; // for the area not covered by children
+    split_child_t * ca; // children array
+    size_t cn; // number of children
+    size_t cm; // allocated entries in children array
+    unsigned int used; // cells along the split axis covered by children
+    uint8_t dir;
+    uint8_t layout_valid;
+};
+
 #if _DEBUG
 #include <stdlib.h>
 #include <stdio.h>
@@ -104,6 +416,13 @@ struct itxt_win_s
 #define L2(...) ((void) 0)
 #endif
 
+#define ATOMIC_LOAD(_p) __atomic_load_n((_p), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(_p, _v) __atomic_store_n((_p), (_v), __ATOMIC_RELEASE)
+#define ATOMIC_XCHG(_p, _v) __atomic_exchange_n((_p), (_v), __ATOMIC_ACQ_REL)
+#define ATOMIC_CAS(_p, _e, _v) __atomic_compare_exchange_n((_p), (_e), (_v), \
+    1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define ATOMIC_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
 #define O(_x) \
     if ((cs = (_x))) { \
         L("%s failed: %u", #_x, cs); \
@@ -111,13 +430,369 @@ struct itxt_win_s
         break; \
     } else (void) 0
 
+/* scan_ctl *****************************************************************/
+/**
+ *  Returns a pointer to the first '\n', '\a' or NUL byte in a NUL-terminated
+ *  string. Set to the fastest implementation the processor supports on
+ *  first use.
+ */
+extern uint8_t const * (ZLX_CALL * scan_ctl) (uint8_t const * p);
+
+/* scan_nl ******************************************************************/
+/**
+ *  Returns a pointer to the first '\n' in [p, e), or e if there is none.
+ */
+extern uint8_t const * (ZLX_CALL * scan_nl) (uint8_t const * p,
+                                             uint8_t const * e);
+
+/* scan_ascii ***************************************************************/
+/**
+ *  Returns a pointer to the first byte in [p, e) that is not printable ASCII
+ *  (0x20 - 0x7E), or e if there is none.
+ */
+extern uint8_t const * (ZLX_CALL * scan_ascii) (uint8_t const * p,
+                                                uint8_t const * e);
+
+/* two-level code point tables generated by ucdgen.py: each entry holds
+ * width + 1 in bits 0-1 and the word class in bits 2-3 */
+extern uint8_t const ucd_stage1[0x1100];
+extern uint8_t const ucd_stage2[][0x100];
+
+/* ucd_width ****************************************************************/
+/**
+ *  Returns the number of columns taken by a code point: 0 for combining
+ *  marks, 1 or 2 for printable chars, -1 for control chars and invalid
+ *  code points.
+ */
+ZLX_INLINE int ucd_width (uint32_t ucp)
+{
+    if (ucp >= 0x110000) return -1;
+    return (ucd_stage2[ucd_stage1[ucp >> 8]][ucp & 0xFF] & 3) - 1;
+}
+
+/* ucd_class ****************************************************************/
+/**
+ *  Returns the word class of a code point: 0 for spaces, 1 for control
+ *  chars, 2 for letters, digits, marks and connectors, 3 for the rest.
+ */
+ZLX_INLINE unsigned int ucd_class (uint32_t ucp)
+{
+    if (ucp >= 0x110000) return 3;
+    return ucd_stage2[ucd_stage1[ucp >> 8]][ucp & 0xFF] >> 2;
+}
+
+/* the acx1 console; the backend of instances made by twx_create() */
+extern twx_backend_t console_backend;
+
 twx_status_t ZLX_CALL htxt_draw (twx_win_t * win, unsigned int mode);
+twx_status_t ZLX_CALL htxt_handler (twx_win_t * win, unsigned int evt,
+                                    twx_event_info_t * ei);
 void ZLX_CALL htxt_finish (twx_win_t * win);
 
+/* htxt_init ****************************************************************/
+/**
+ *  Initialises the hypertext part of a freshly allocated window (also used
+ *  by the classes built on top of htxt).
+ */
+twx_status_t htxt_init (htxt_win_t * hw, acx1_attr_t * attr_a, size_t attr_n);
+
+/* htxt_nl_attr *************************************************************/
+/**
+ *  Tells whether the '\n' at q is the attribute byte of a '\a' escape
+ *  rather than the end of the row starting at s.
+ */
+ZLX_INLINE int htxt_nl_attr (uint8_t const * s, uint8_t const * q)
+{
+    uint8_t const * a;
+
+    for (a = q; a > s && a[-1] == '\a'; --a);
+    return (q - a) & 1;
+}
+
+/* htxt_append_ref **********************************************************/
+/**
+ *  Appends rows referring to the lines in [p, e) and damages the ones in
+ *  view; the window does not scroll to follow them.
+ *  Can be called from any thread.
+ */
+twx_status_t htxt_append_ref (htxt_win_t * hw, uint8_t const * p,
+                              uint8_t const * e);
+
 twx_status_t ZLX_CALL blank_draw (twx_win_t * win, unsigned int mode);
 
 void * win_alloc (twx_t * twx, twx_win_class_t * wcls);
 
+/* instance whose twx_run() runs on the calling thread, or NULL */
+extern TWX_TLS twx_t * ui_twx;
+
+/* win_event ****************************************************************/
+/**
+ *  Calls the handler of the window, updating the stats when called on the
+ *  thread running twx_run(); the stats are not shared with other threads.
+ *  Windows must get their events only through this.
+ */
+twx_status_t win_event (twx_win_t * win, unsigned int evt,
+                        twx_event_info_t * ei);
+
+/* wake_main ****************************************************************/
+/**
+ *  Wakes up twx_run() if it is sleeping (or about to sleep) on main.
+ *  Must be called after publishing the new work with a release store so
+ *  that work posted without taking the main lock is never missed.
+ */
+void wake_main (twx_t * twx);
+
+/* timer_init ***************************************************************/
+/**
+ *  Sets up the empty timer wheel.
+ */
+void timer_init (twx_t * twx);
+
+/* timer_free ***************************************************************/
+/**
+ *  Frees all timers.
+ */
+void timer_free (twx_t * twx);
+
+/* timer_stop_win ***********************************************************/
+/**
+ *  Stops all timers of a window.
+ */
+void timer_stop_win (twx_win_t * win);
+
+/* timer_next ***************************************************************/
+/**
+ *  Returns the clock_us() time when the timer wheel has work next, or 0
+ *  when no timers are running.
+ */
+uint64_t timer_next (twx_t * twx);
+
+/* timer_due ****************************************************************/
+/**
+ *  Tells whether the timer wheel has work at the given time.
+ */
+int timer_due (twx_t * twx, uint64_t now);
+
+/* timer_run ****************************************************************/
+/**
+ *  Sends TWX_TIMER to the windows whose timers expired, restarting them.
+ *  @returns the number of events sent
+ */
+unsigned int timer_run (twx_t * twx, twx_status_t * ts_ptr);
+
+/* clock_us *****************************************************************/
+/**
+ *  Returns the time in microseconds from a monotonic clock.
+ */
+uint64_t clock_us (void);
+
+#if TWX_TRACE
+
+/* trace_init ***************************************************************/
+/**
+ *  Allocates the trace rings.
+ */
+twx_status_t trace_init (twx_t * twx);
+
+/* trace_free ***************************************************************/
+void trace_free (twx_t * twx);
+
+/* trace_add ****************************************************************/
+/**
+ *  Appends a record to the ring of the given thread, which must be the
+ *  calling one. Records for TRACE_MAIN made on any other thread than the
+ *  one running twx_run(), as by windows called from workers, are dropped.
+ */
+void trace_add (twx_t * twx, unsigned int thread, unsigned int kind,
+                uint64_t t0, uint64_t t1, void const * p, uint32_t arg,
+                uint32_t id);
+
+#define TRACE(...) trace_add(__VA_ARGS__)
+#define TRACE_NOW() clock_ns()
+#else
+#define TRACE(...) ((void) 0)
+#define TRACE_NOW() ((uint64_t) 0)
+#endif
+
+/* clock_ns *****************************************************************/
+/**
+ *  Returns the time in nanoseconds from a monotonic clock.
+ */
+uint64_t clock_ns (void);
+
+/* clock_nap ****************************************************************/
+/**
+ *  Suspends the calling thread for about the given number of microseconds.
+ */
+void clock_nap (unsigned int usec);
+
+/* tcond_create *************************************************************/
+/**
+ *  Creates a lock with a condition variable that can be waited on with a
+ *  timeout, which hbs does not provide.
+ */
+twx_status_t tcond_create (twx_tcond_t * * tc_ptr);
+
+/* tcond_destroy ************************************************************/
+void tcond_destroy (twx_tcond_t * tc);
+
+void tcond_lock (twx_tcond_t * tc);
+void tcond_unlock (twx_tcond_t * tc);
+void tcond_signal (twx_tcond_t * tc);
+
+/* tcond_wait ***************************************************************/
+/**
+ *  Waits with the lock held until signalled or, if at is not 0, until the
+ *  clock_us() time at is reached; may also return spuriously.
+ */
+void tcond_wait (twx_tcond_t * tc, uint64_t at);
+
+/* fb_resize ****************************************************************/
+/**
+ *  Resizes the frame buffer grids to the given screen size.
+ *  Both grids are reset to blank and the terminal is cleared on the next
+ *  flush.
+ */
+twx_status_t fb_resize (twx_t * twx, unsigned int height, unsigned int width);
+
+/* fb_free ******************************************************************/
+void fb_free (twx_t * twx);
+
+/* fb_fill ******************************************************************/
+/**
+ *  Renders n copies of ch into the back grid starting at the given screen
+ *  position (1-based, like window geometry).
+ */
+void fb_fill (twx_t * twx, unsigned int row, unsigned int col, unsigned int n,
+              uint32_t ch, acx1_attr_t const * attr);
+
+/* fb_write *****************************************************************/
+/**
+ *  Renders UTF8 text into the back grid, using at most width columns.
+ *  Returns the number of columns used.
+ */
+unsigned int fb_write (twx_t * twx, unsigned int row, unsigned int col,
+                       unsigned int width, uint8_t const * text, size_t len,
+                       acx1_attr_t const * attr);
+
+/* fb_scroll ****************************************************************/
+/**
+ *  Moves the content of the given screen rectangle of the back grid by n
+ *  rows (up if n > 0); the rows exposed by the move keep stale content and
+ *  must be redrawn.
+ *  When the rectangle spans the whole screen width and the terminal 
+ *  supports scroll regions, the terminal is asked to scroll those rows as
+ *  well, so that the next flush only needs to send the exposed rows.
+ */
+void fb_scroll (twx_t * twx, unsigned int row, unsigned int col,
+                unsigned int height, unsigned int width, int n);
+
+/* fb_cursor ****************************************************************/
+/**
+ *  Requests the cursor to be placed at the given screen position after the
+ *  next flush. A position past the screen is moved to its edge, as the
+ *  terminal would.
+ */
+void fb_cursor (twx_t * twx, unsigned int row, unsigned int col);
+
+/* win_draw_begin ***********************************************************/
+/**
+ *  Prepares the drawing of the damaged region of a window: clips frame
+ *  buffer output to the damage (or to the whole window if the update flag
+ *  was set without any damage) and clears both the damage and the update
+ *  flag.
+ *  Stores in *top and *bottom the range of window rows to be redrawn.
+ */
+void win_draw_begin (twx_win_t * win, unsigned int * top,
+                     unsigned int * bottom);
+
+/* win_draw_end *************************************************************/
+/**
+ *  Removes the clipping set by win_draw_begin().
+ */
+void win_draw_end (twx_win_t * win);
+
+/* fb_flush *****************************************************************/
+/**
+ *  Sends to the terminal the cells in the back grid that differ from the
+ *  front grid, then makes the front grid match the back grid.
+ *  Must be called between out_begin() and out_end().
+ */
+twx_status_t fb_flush (twx_t * twx);
+
+/* The output encoder keeps track of the terminal state (cursor position
+ * and visibility, attribute) to send only what changes, encoded in as few
+ * bytes as the backend capabilities allow. Output is gathered in out_a,
+ * which grows to hold a whole frame, so VT backends get one write per
+ * frame; other backends also get it before each of their other operations.
+ * The functions return 0 or the error of the backend. */
+
+/* out_begin ****************************************************************/
+/**
+ *  Starts a frame; the terminal holds its display until out_end() when it
+ *  supports synchronized output.
+ */
+unsigned int out_begin (twx_t * twx);
+
+/* out_end ******************************************************************/
+/**
+ *  Sends the gathered output and ends the frame.
+ */
+unsigned int out_end (twx_t * twx);
+
+/* out_flush ****************************************************************/
+/**
+ *  Gives the gathered output to the backend in one write.
+ */
+unsigned int out_flush (twx_t * twx);
+
+/* out_raw ******************************************************************/
+/**
+ *  Sends an escape sequence after which the cursor position is unknown.
+ */
+unsigned int out_raw (twx_t * twx, void const * p, size_t n);
+
+/* out_move *****************************************************************/
+/**
+ *  Moves the cursor to the 1-based screen position with the shortest of
+ *  absolute, relative and CR/LF moves.
+ */
+unsigned int out_move (twx_t * twx, unsigned int row, unsigned int col);
+
+/* out_attr *****************************************************************/
+/**
+ *  Sets the attribute for the following output unless already set.
+ */
+unsigned int out_attr (twx_t * twx, unsigned int bg, unsigned int fg,
+                       unsigned int mode);
+
+/* out_clear ****************************************************************/
+/**
+ *  Clears the screen with the current attribute.
+ */
+unsigned int out_clear (twx_t * twx);
+
+/* out_cells ****************************************************************/
+/**
+ *  Writes n cells of a row starting at the cursor, with their attributes.
+ *  Runs of the same char are sent as erase or repeat sequences when the
+ *  terminal supports them and that is shorter.
+ */
+unsigned int out_cells (twx_t * twx, twx_cell_t const * c, unsigned int n);
+
+/* out_cursor ***************************************************************/
+/**
+ *  Places the visible cursor at the 1-based screen position.
+ */
+unsigned int out_cursor (twx_t * twx, unsigned int row, unsigned int col);
+
+/* out_cursor_mode **********************************************************/
+/**
+ *  Shows (1) or hides (0) the cursor unless already done; outside a frame
+ *  the change is sent at once.
+ */
+unsigned int out_cursor_mode (twx_t * twx, unsigned int mode);
+
 
 #endif /* TWX_INTERN_H */
 
@@ -10,6 +10,9 @@ static size_t text_bwd (uint8_t const * p, uint8_t const * q,
 
 static unsigned int ZLX_CALL char_normal_group (uint32_t ucp);
 
+static int text_measure (uint8_t const * p, size_t len, size_t max_width,
+                         size_t * size, size_t * width);
+
 void ZLX_CALL itxt_finish (twx_win_t * win);
 twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
                                     twx_event_info_t * ei);
@@ -32,13 +35,53 @@ twx_win_class_t itxt_wcls =
 /* char_normal_group ********************************************************/
 static unsigned int ZLX_CALL char_normal_group (uint32_t ucp)
 {
-    if (ucp == ' ') return 0;
-    if (ucp < 0x20) return 1;
-    if (ucp >= 'A' && ucp <= 'Z') return 2;
-    if (ucp >= 'a' && ucp <= 'z') return 2;
-    if (ucp >= '0' && ucp <= '9') return 2;
-    if (ucp == '_') return 2;
-    return 3;
+    return ucd_class(ucp);
+}
+
+/* text_measure *************************************************************/
+/**
+ *  Measures the UTF-8 text in [p, p + len) up to max_width columns.
+ *  Sets *size to the bytes measured and *width to their columns.
+ *  @returns 0 if all the text fits, 2 if measuring stopped at a char that
+ *  does not fit, -1 on malformed UTF-8, -2 on a char that is not printable
+ */
+static int text_measure (uint8_t const * p, size_t len, size_t max_width,
+                         size_t * size, size_t * width)
+{
+    uint8_t const * s = p;
+    uint8_t const * e = p + len;
+    size_t w = 0, k;
+    ptrdiff_t l;
+    uint32_t ucp;
+    int cw, r = 0;
+
+    while (p < e)
+    {
+        if (*p >= 0x20 && *p < 0x7F)
+        {
+            k = scan_ascii(p, e) - p;
+            if (k > max_width - w)
+            {
+                p += max_width - w;
+                w = max_width;
+                r = 2;
+                break;
+            }
+            p += k;
+            w += k;
+            continue;
+        }
+        l = zlx_utf8_to_ucp(p, e, 0, &ucp);
+        if (l <= 0) { r = -1; break; }
+        cw = ucd_width(ucp);
+        if (cw < 0) { r = -2; break; }
+        if ((size_t) cw > max_width - w) { r = 2; break; }
+        w += cw;
+        p += l;
+    }
+    *size = p - s;
+    *width = w;
+    return r;
 }
 
 /* text_fwd_group ***********************************************************/
@@ -99,6 +142,166 @@ static uint8_t * text_bwd_group (uint8_t const * p, uint8_t const * q,
     return (uint8_t *) q;
 }
 
+/* printable_run ************************************************************/
+/**
+ *  Returns the number of keys at the start of km_a that insert a char.
+ */
+static size_t printable_run (uint32_t const * km_a, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; ++i)
+        if (km_a[i] < 0x20 || km_a[i] >= 0x110000 
+            || ucd_width(km_a[i]) < 0) break;
+    return i;
+}
+
+/* text_after ***************************************************************/
+/**
+ *  The text is kept in a gap buffer with the gap at the cursor: the bytes
+ *  before the cursor start at text, the ones after it end at
+ *  text + text_size. This returns the start of the bytes after the cursor.
+ */
+ZLX_INLINE uint8_t * text_after (itxt_win_t * itw)
+{
+    return itw->text + itw->text_size - (itw->text_n - itw->cursor_ofs);
+}
+
+/* text_end *****************************************************************/
+ZLX_INLINE uint8_t * text_end (itxt_win_t * itw)
+{
+    return itw->text + itw->text_size;
+}
+
+/* text_at ******************************************************************/
+/**
+ *  Returns a pointer to the byte at the given offset in the text and sets
+ *  *end to the end of the contiguous part it belongs to.
+ */
+static uint8_t const * text_at (itxt_win_t * itw, size_t ofs,
+                                uint8_t const * * end)
+{
+    if (ofs < itw->cursor_ofs)
+    {
+        *end = itw->text + itw->cursor_ofs;
+        return itw->text + ofs;
+    }
+    *end = text_end(itw);
+    return text_after(itw) + (ofs - itw->cursor_ofs);
+}
+
+/* move_cursor **************************************************************/
+/**
+ *  Moves the cursor, and the gap along with it, to the given offset.
+ */
+static void move_cursor (itxt_win_t * itw, size_t co)
+{
+    size_t g = itw->text_size - itw->text_n;
+
+    if (co < itw->cursor_ofs)
+        memmove(itw->text + co + g, itw->text + co, itw->cursor_ofs - co);
+    else
+        memmove(itw->text + itw->cursor_ofs, itw->text + itw->cursor_ofs + g,
+                co - itw->cursor_ofs);
+    itw->cursor_ofs = co;
+}
+
+/* widen_gap ****************************************************************/
+/**
+ *  Makes room for at least l bytes in the gap.
+ */
+static twx_status_t widen_gap (itxt_win_t * itw, size_t l)
+{
+    uint8_t * p;
+    size_t m, a;
+
+    if (itw->text_size - itw->text_n >= l) return TWX_OK;
+    /* doubling keeps long runs of inserts linear */
+    m = itw->text_size * 2;
+    if (m < itw->text_n + l + 16) m = (itw->text_n + l + 16) & ~(size_t) 15;
+    p = hbs_realloc(itw->text, itw->text_size, m);
+    if (!p) return TWX_NO_MEM;
+    a = itw->text_n - itw->cursor_ofs;
+    memmove(p + m - a, p + itw->text_size - a, a);
+    itw->text = p;
+    itw->text_size = m;
+    return TWX_OK;
+}
+
+/* insert_keys **************************************************************/
+/**
+ *  Inserts at the cursor the chars for the given printable keys with a 
+ *  single resize of the text buffer, then refits the cursor and 
+ *  invalidates the window once.
+ */
+static twx_status_t insert_keys (itxt_win_t * itw, uint32_t const * km_a,
+                                 size_t n)
+{
+    uint8_t * p;
+    size_t i, l;
+
+    for (l = i = 0; i < n; ++i) l += zlx_ucp_to_utf8_len(km_a[i]);
+    if (widen_gap(itw, l)) return TWX_NO_MEM;
+    p = itw->text + itw->cursor_ofs;
+    itw->text_n += l;
+    for (i = 0; i < n; ++i)
+    {
+        zlxi_ucp_to_utf8(km_a[i], p);
+        p += zlx_ucp_to_utf8_len(km_a[i]);
+    }
+    itw->cursor_ofs += l;
+    fit_cursor(itw);
+    twx_win_refresh(&itw->base);
+    return TWX_OK;
+}
+
+/* insert_paste *************************************************************/
+/**
+ *  Inserts pasted text at the cursor in one go. The input is a single
+ *  line, so line breaks and tabs become spaces; malformed UTF-8 and other
+ *  chars that cannot be displayed are dropped.
+ */
+static twx_status_t insert_paste (itxt_win_t * itw, uint8_t const * p,
+                                  size_t n)
+{
+    uint8_t const * s = p;
+    uint8_t const * e = p + n;
+    uint8_t const * q;
+    uint8_t * o;
+    ptrdiff_t l;
+    uint32_t ucp;
+
+    /* nothing grows when filtered */
+    if (widen_gap(itw, n)) return TWX_NO_MEM;
+    o = itw->text + itw->cursor_ofs;
+    while (p < e)
+    {
+        q = scan_ascii(p, e);
+        memcpy(o, p, q - p);
+        o += q - p;
+        if (q == e) break;
+        p = q;
+        l = zlx_utf8_to_ucp(p, e, 0, &ucp);
+        if (l <= 0) { ++p; continue; }
+        if (ucp == '\r' || ucp == '\n' || ucp == '\t')
+        {
+            /* CR LF makes a single space */
+            if (ucp != '\n' || p == s || p[-1] != '\r') *o++ = ' ';
+        }
+        else if (ucd_width(ucp) >= 0)
+        {
+            memcpy(o, p, l);
+            o += l;
+        }
+        p += l;
+    }
+    n = o - (itw->text + itw->cursor_ofs);
+    itw->text_n += n;
+    itw->cursor_ofs += n;
+    fit_cursor(itw);
+    twx_win_refresh(&itw->base);
+    return TWX_OK;
+}
+
 /* itxt_finish **************************************************************/
 void ZLX_CALL itxt_finish (twx_win_t * win)
 {
@@ -112,9 +315,10 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
                                     twx_event_info_t * ei)
 {
     itxt_win_t * itw = (itxt_win_t *) win;
+    twx_t * twx;
     uint8_t * p;
     twx_event_info_t e;
-    unsigned int cs, l;
+    unsigned int cs, top, bottom;
     twx_status_t ts = TWX_OK;
     uint32_t km, ucp;
     size_t i, tw, tb;
@@ -123,58 +327,55 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
     {
     case TWX_DRAW:
         if (!(win->flags & TWX_WF_UPDATE)) break;
-        win->flags &= ~TWX_WF_UPDATE;
-        O(acx1_write_pos(win->scr_row, win->scr_col));
+        win_draw_begin(win, &top, &bottom);
+        twx = win->twx;
         if (itw->pfx_width + 5 > win->width)
         {
-            O(acx1_attr(itw->attr_a[TWX_ITXT_ATTR_MARK].bg,
-                        itw->attr_a[TWX_ITXT_ATTR_MARK].fg,
-                        itw->attr_a[TWX_ITXT_ATTR_MARK].mode));
-            O(acx1_fill('-', win->width));
+            fb_fill(twx, win->scr_row, win->scr_col, win->width, '-',
+                    &itw->attr_a[TWX_ITXT_ATTR_MARK]);
+            win_draw_end(win);
+            fb_cursor(twx, win->scr_row, win->scr_col);
             break;
         }
 
+        tw = 0;
         if (itw->pfx_size)
-        {
-            O(acx1_attr(itw->attr_a[TWX_ITXT_ATTR_PFX].bg,
-                        itw->attr_a[TWX_ITXT_ATTR_PFX].fg,
-                        itw->attr_a[TWX_ITXT_ATTR_PFX].mode));
-            O(acx1_write(itw->pfx, itw->pfx_size));
-        }
-        tw = itw->pfx_width;
+            tw += fb_write(twx, win->scr_row, win->scr_col, win->width,
+                           itw->pfx, itw->pfx_size,
+                           &itw->attr_a[TWX_ITXT_ATTR_PFX]);
 
         if (itw->view_ofs)
         {
-            O(acx1_attr(itw->attr_a[TWX_ITXT_ATTR_MARK].bg,
-                        itw->attr_a[TWX_ITXT_ATTR_MARK].fg,
-                        itw->attr_a[TWX_ITXT_ATTR_MARK].mode));
-            O(acx1_fill('<', 1));
+            fb_fill(twx, win->scr_row, win->scr_col + tw, 1, '<',
+                    &itw->attr_a[TWX_ITXT_ATTR_MARK]);
             tw++;
         }
 
-        O(acx1_attr(itw->attr_a[TWX_ITXT_ATTR_TXT].bg,
-                    itw->attr_a[TWX_ITXT_ATTR_TXT].fg,
-                    itw->attr_a[TWX_ITXT_ATTR_TXT].mode));
-
-        O(acx1_write(itw->text + itw->view_ofs, itw->view_size));
-        tw += itw->view_width;
+        /* the view spans the gap at the cursor */
+        i = itw->cursor_ofs - itw->view_ofs;
+        if (i > itw->view_size) i = itw->view_size;
+        tw += fb_write(twx, win->scr_row, win->scr_col + tw, win->width - tw,
+                       itw->text + itw->view_ofs, i,
+                       &itw->attr_a[TWX_ITXT_ATTR_TXT]);
+        tw += fb_write(twx, win->scr_row, win->scr_col + tw, win->width - tw,
+                       text_after(itw), itw->view_size - i,
+                       &itw->attr_a[TWX_ITXT_ATTR_TXT]);
         if (itw->view_ofs + itw->view_size < itw->text_n)
         {
-            O(acx1_attr(itw->attr_a[TWX_ITXT_ATTR_MARK].bg,
-                        itw->attr_a[TWX_ITXT_ATTR_MARK].fg,
-                        itw->attr_a[TWX_ITXT_ATTR_MARK].mode));
-            O(acx1_fill('>', 1));
+            fb_fill(twx, win->scr_row, win->scr_col + tw, 1, '>',
+                    &itw->attr_a[TWX_ITXT_ATTR_MARK]);
             tw++;
         }
 
         if (tw < win->width)
-        {
-            O(acx1_fill(' ', win->width - tw));
-        }
-
-        O(acx1_set_cursor_pos(win->scr_row,
-                              win->scr_col + itw->pfx_size 
-                              + (itw->view_ofs != 0) + itw->cursor_col));
+            fb_fill(twx, win->scr_row, win->scr_col + tw, win->width - tw, ' ',
+                    &itw->attr_a[itw->view_ofs + itw->view_size < itw->text_n
+                                 ? TWX_ITXT_ATTR_MARK : TWX_ITXT_ATTR_TXT]);
+
+        win_draw_end(win);
+        fb_cursor(twx, win->scr_row,
+                  win->scr_col + itw->pfx_width
+                  + (itw->view_ofs != 0) + itw->cursor_col);
         break;
 
     case TWX_KEY:
@@ -184,21 +385,19 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
             /* exits */
         case ACX1_ENTER:
             e.id = itw->ntf_id;
-            ts = itw->ntf_win->wcls->handler(itw->ntf_win, 
-                                             TWX_ITXT_ENTERED, &e);
+            ts = win_event(itw->ntf_win, TWX_ITXT_ENTERED, &e);
             break;
 
         case ACX1_ESC:
             e.id = itw->ntf_id;
-            ts = itw->ntf_win->wcls->handler(itw->ntf_win, 
-                                             TWX_ITXT_CANCELLED, &e);
+            ts = win_event(itw->ntf_win, TWX_ITXT_CANCELLED, &e);
             break;
 
             /* movement */
         case ACX1_HOME:
         case ACX1_CTRL | 'A':
             itw->view_ofs = 0;
-            itw->cursor_ofs = 0;
+            move_cursor(itw, 0);
             //itw->cursor_col = 0;
             fit_cursor(itw);
             twx_win_refresh(win);
@@ -206,7 +405,7 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
 
         case ACX1_END:
         case ACX1_CTRL | 'E':
-            itw->cursor_ofs = itw->text_n;
+            move_cursor(itw, itw->text_n);
             //itw->cursor_col = tw;
             fit_cursor(itw);
             twx_win_refresh(win);
@@ -216,17 +415,16 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
         case ACX1_CTRL | 'B':
             tb = text_bwd(itw->text, itw->text + itw->cursor_ofs, NULL);
             if (!tb) break;
-            itw->cursor_ofs -= tb;
+            move_cursor(itw, itw->cursor_ofs - tb);
             fit_cursor(itw);
             twx_win_refresh(win);
             break;
 
         case ACX1_RIGHT:
         case ACX1_CTRL | 'F':
-            tb = text_fwd(itw->text + itw->cursor_ofs, 
-                          itw->text + itw->text_n, NULL);
+            tb = text_fwd(text_after(itw), text_end(itw), NULL);
             if (!tb) break;
-            itw->cursor_ofs += tb;
+            move_cursor(itw, itw->cursor_ofs + tb);
             fit_cursor(itw);
             twx_win_refresh(win);
             break;
@@ -236,7 +434,7 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
             if (!itw->cursor_ofs) break;
             p = text_bwd_group(itw->text, itw->text + itw->cursor_ofs,
                                char_normal_group);
-            itw->cursor_ofs = p - itw->text;
+            move_cursor(itw, p - itw->text);
             fit_cursor(itw);
             twx_win_refresh(win);
             break;
@@ -244,10 +442,9 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
         case ACX1_CTRL | ACX1_RIGHT:
         case ACX1_ALT | 'f':
             if (itw->cursor_ofs == itw->text_n) break;
-            p = text_fwd_group(itw->text + itw->cursor_ofs,
-                               itw->text + itw->text_n,
+            p = text_fwd_group(text_after(itw), text_end(itw),
                                char_normal_group);
-            itw->cursor_ofs = p - itw->text;
+            move_cursor(itw, itw->cursor_ofs + (p - text_after(itw)));
             fit_cursor(itw);
             twx_win_refresh(win);
             break;
@@ -259,9 +456,7 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
             for (i = itw->cursor_ofs - 1;
                  i && (itw->text[i] & 0xC0) == 0x80;
                  --i);
-            memmove(itw->text + i,
-                    itw->text + itw->cursor_ofs,
-                    itw->text_n - itw->cursor_ofs);
+            /* deleting next to the cursor just widens the gap */
             itw->text_n -= itw->cursor_ofs - i;
             itw->cursor_ofs = i;
             fit_cursor(itw);
@@ -271,12 +466,7 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
         case ACX1_DEL:
         case ACX1_CTRL | 'D':
             if (itw->cursor_ofs == itw->text_n) break;
-            tb = zlx_utf8_to_ucp(itw->text + itw->cursor_ofs, 
-                                 itw->text + itw->text_n, 0, &ucp);
-            i = itw->cursor_ofs + tb;
-            memmove(itw->text + itw->cursor_ofs, 
-                    itw->text + i, 
-                    itw->text_n - i);
+            tb = zlx_utf8_to_ucp(text_after(itw), text_end(itw), 0, &ucp);
             itw->text_n -= tb;
             fit_cursor(itw);
             twx_win_refresh(win);
@@ -291,8 +481,6 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
 
         case ACX1_CTRL | 'U':
             if (!itw->cursor_ofs) break;
-            memmove(itw->text, itw->text + itw->cursor_ofs, 
-                    itw->text_n - itw->cursor_ofs);
             itw->text_n -= itw->cursor_ofs;
             itw->cursor_ofs = 0;
             fit_cursor(itw);
@@ -304,8 +492,6 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
             if (!itw->cursor_ofs) break;
             p = text_bwd_group(itw->text, itw->text + itw->cursor_ofs,
                                char_normal_group);
-            memmove(p, itw->text + itw->cursor_ofs, 
-                    itw->text_n - itw->cursor_ofs);
             itw->text_n -= itw->text + itw->cursor_ofs - p;
             itw->cursor_ofs = p - itw->text;
             fit_cursor(itw);
@@ -315,38 +501,46 @@ twx_status_t ZLX_CALL itxt_handler (twx_win_t * win, unsigned int evt,
         case ACX1_CTRL | ACX1_DEL:
         case ACX1_ALT | 'd':
             if (itw->cursor_ofs == itw->text_n) break;
-            p = text_fwd_group(itw->text + itw->cursor_ofs,
-                               itw->text + itw->text_n,
+            p = text_fwd_group(text_after(itw), text_end(itw),
                                char_normal_group);
-            memmove(itw->text + itw->cursor_ofs, p, 
-                    itw->text + itw->text_n - p);
-            itw->text_n -= p - itw->text - itw->cursor_ofs;
+            itw->text_n -= p - text_after(itw);
             fit_cursor(itw);
             twx_win_refresh(win);
             break;
 
         default:
-            if (km < 0x20 || km >= 0x110000 || acx1_term_char_width(km) < 0)
-                break;
-            l = zlx_ucp_to_utf8_len(km);
-            p = zlx_u8a_insert(&itw->text, &itw->text_n, &itw->text_size, 
-                               itw->cursor_ofs, l, hbs_ma);
-            if (!p) return TWX_NO_MEM;
-            zlxi_ucp_to_utf8(km, p);
-            itw->cursor_ofs += l;
-            //itw->cursor_col += acx1_term_char_width(km);
-            fit_cursor(itw);
-            twx_win_refresh(win);
-            //twx_refresh(win->twx);
+            if (!printable_run(&km, 1)) break;
+            ts = insert_keys(itw, &km, 1);
         }
         break;
 
+    case TWX_KEYS:
+        /* insert a run of printable keys at once; anything else is left
+         * for TWX_KEY */
+        i = printable_run(ei->keys.km_a, ei->keys.n);
+        if (!i) break;
+        ts = insert_keys(itw, ei->keys.km_a, i);
+        if (!ts) ei->keys.used = i;
+        break;
+
+    case TWX_PASTE:
+        ts = insert_paste(itw, ei->paste.data, ei->paste.size);
+        break;
+
+    case TWX_GEOM:
+        ts = twx_default_handler(win, evt, ei);
+        /* place the view for the new width; TWX_INVALIDATE follows */
+        if (itw->pfx_width + 5 <= win->width) fit_cursor(itw);
+        break;
+
     case TWX_FOCUS:
-        O(acx1_set_cursor_mode(1));
+        twx = win->twx;
+        O(out_cursor_mode(twx, 1));
         break;
 
     case TWX_UNFOCUS:
-        O(acx1_set_cursor_mode(0));
+        twx = win->twx;
+        O(out_cursor_mode(twx, 0));
         break;
 
     default:
@@ -370,22 +564,20 @@ TWX_API twx_status_t ZLX_CALL twx_itxt_win_create
 )
 {
     itxt_win_t * itw;
-    size_t pb, pc, pw;
-    size_t tb, tc, tw;
+    size_t pb, pw;
+    size_t tb, tw;
 
     if (pfx)
     {
-        if (acx1_utf8_str_measure(acx1_term_char_width_wctx, NULL,
-                                  pfx, strlen(pfx), SIZE_MAX, SIZE_MAX,
-                                  &pb, &pc, &pw) < 0)
+        if (text_measure((uint8_t const *) pfx, strlen(pfx), SIZE_MAX,
+                         &pb, &pw) < 0)
             return TWX_BAD_STRING;
     }
 
     if (init_text)
     {
-        if (acx1_utf8_str_measure(acx1_term_char_width_wctx, NULL,
-                                  init_text, strlen(init_text),
-                                  SIZE_MAX, SIZE_MAX, &tb, &tc, &tw) < 0)
+        if (text_measure((uint8_t const *) init_text, strlen(init_text),
+                         SIZE_MAX, &tb, &tw) < 0)
             return TWX_BAD_STRING;
     }
 
@@ -440,7 +632,7 @@ static size_t text_fwd (uint8_t const * p, uint8_t const * q,
     if (p == q) { if (width) *width = 0; return 0; }
     l = zlx_utf8_to_ucp(p, q, 0, &ucp);
     A(l > 0);
-    cw = acx1_term_char_width(ucp);
+    cw = ucd_width(ucp);
     if (cw < 0) cw = 1;
     if (width) *width = cw;
     r = p + l;
@@ -449,7 +641,7 @@ static size_t text_fwd (uint8_t const * p, uint8_t const * q,
     {
         l = zlx_utf8_to_ucp(r, q, 0, &ucp);
         A(l > 0);
-        cw = acx1_term_char_width(ucp);
+        cw = ucd_width(ucp);
         if (cw) break;
         r += l;
     }
@@ -475,7 +667,7 @@ static size_t text_bwd (uint8_t const * p, uint8_t const * q,
         l = zlx_utf8_to_ucp(r, q, 0, &ucp);
         A(r + l == q);
         (void) l;
-        cw = acx1_term_char_width(ucp);
+        cw = ucd_width(ucp);
         if (cw) break;
     }
     if (width) *width = 1 + (cw == 2);
@@ -491,17 +683,22 @@ static void ZLX_CALL fit_cursor (itxt_win_t * itw)
     size_t co = itw->cursor_ofs;
     size_t vo = itw->view_ofs;
     size_t w = itw->base.width - itw->pfx_width;
-    size_t tb, tc, tw, tn, vso, wl;
+    size_t tb, tw, tn, vso, wl, mw;
     int m;
     int mwr, cw, cl;
     unsigned int sw;
     uint32_t ucp;
     uint8_t const * t;
+    uint8_t const * a;
     uint8_t const * e;
+    uint8_t const * r;
+    uint8_t const * re;
 
+    /* [t, t + co) is the text before the cursor, [a, e) the text after */
     tn = itw->text_n;
     t = itw->text;
-    e = t + tn;
+    a = text_after(itw);
+    e = text_end(itw);
 
     L("at entry: vo=0x%X, co=0x%X, w=0x%X", (int) vo, (int) co, (int) w);
     if (vo >= co)
@@ -522,43 +719,66 @@ static void ZLX_CALL fit_cursor (itxt_win_t * itw)
         if (co == tn) mwr = 1;
         else
         {
-            cl = (int) zlx_utf8_to_ucp(t + co, e, 0, &ucp);
+            cl = (int) zlx_utf8_to_ucp(a, e, 0, &ucp);
             A(cl > 0);
-            mwr = acx1_term_char_width(ucp);
+            mwr = ucd_width(ucp);
             A(mwr >= 0);
             mwr += (co + cl < tn);
         }
 
-        // compute width from vo to co
+        // compute width from vo to co; measuring stops once it exceeds the
+        // window so that the cost does not depend on how far the cursor
+        // moved
         wl = (vo != 0);
-        m = acx1_utf8_str_measure(acx1_term_char_width_wctx, NULL, t + vo, 
-                                  co - vo, SIZE_MAX, SIZE_MAX, &tb, &tc, &tw);
-        L("m=%d, tb=0x%X, tc=0x%X, tw=0x%X", m, (int) tb, (int) tc, (int) tw);
-        A(m == 0);
+        m = text_measure(t + vo, co - vo, w, &tb, &tw);
+        L("m=%d, tb=0x%X, tw=0x%X", m, (int) tb, (int) tw);
+        A(m == 0 || m == 2);
         wl += tw;
-        while (wl + mwr > w)
+        if (m == 0)
+        {
+            while (wl + mwr > w && vo < co)
+            {
+                if (!vo) wl++;
+                vo += text_fwd(t + vo, t + co, &sw);
+                wl -= sw;
+                L("vo=0x%X, wl=0x%X", (int) vo, (int) wl);
+            }
+        }
+        else
         {
-            if (!vo) wl++;
-            vo += text_fwd(t + vo, e, &sw);
-            wl -= sw;
+            // the cursor is past the right edge by more than a window:
+            // place the view by walking back from the cursor instead
+            for (vo = co, wl = 1; vo; vo -= tb, wl += sw)
+            {
+                tb = text_bwd(t, t + vo, &sw);
+                if (wl + sw + mwr > w) break;
+            }
             L("vo=0x%X, wl=0x%X", (int) vo, (int) wl);
         }
         itw->cursor_col = wl - (vo != 0);
     }
-    m = acx1_utf8_str_measure(acx1_term_char_width_wctx, NULL,
-                              t + vo, tn - vo, SIZE_MAX, w - 1 - (vo != 0),
-                              &tb, &tc, &tw);
-    L("vo=0x%X, tn-vo=0x%X => m=%d, tb=0x%X, tc=0x%X, tw=0x%X", 
-      (int) vo, (int) (tn - vo), m, (int) tb, (int) tc, (int) tw);
+    /* measure the view on both sides of the gap */
+    mw = w - 1 - (vo != 0);
+    m = text_measure(t + vo, co - vo, mw, &tb, &tw);
+    if (m == 0)
+    {
+        size_t ab, aw;
+        m = text_measure(a, tn - co, mw - tw, &ab, &aw);
+        tb += ab;
+        tw += aw;
+    }
+    L("vo=0x%X, tn-vo=0x%X => m=%d, tb=0x%X, tw=0x%X",
+      (int) vo, (int) (tn - vo), m, (int) tb, (int) tw);
     A(m == 0 || m == 2);
     if (m == 2)
     {
         A(tb < tn - vo);
-        cl = (int) zlx_utf8_to_ucp(t + vo + tb, e, 0, &ucp);
+        r = text_at(itw, vo + tb, &re);
+        cl = (int) zlx_utf8_to_ucp(r, re, 0, &ucp);
         A(cl > 0);
         if (vo + tb + cl == tn)
         {
-            cw = acx1_term_char_width(ucp);
+            cw = ucd_width(ucp);
             A(cw >= 0);
             if (cw == 1) { tb += cl; tw += cw; }
         }
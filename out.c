@@ -0,0 +1,371 @@
+#include <string.h>
+#include "intern.h"
+
+#define OUT_SEQ_MAX 24 // longest cursor move sequence
+
+/* put_uint *****************************************************************/
+static size_t put_uint (uint8_t * b, unsigned int n)
+{
+    uint8_t d[10];
+    size_t i = 0, l;
+
+    do d[i++] = '0' + n % 10; while ((n /= 10));
+    for (l = i; i; --i) *b++ = d[i - 1];
+    return l;
+}
+
+/* put_csi ******************************************************************/
+/**
+ *  Writes ESC [ n f, leaving out n when it is 1 (the default).
+ */
+static size_t put_csi (uint8_t * b, unsigned int n, uint8_t f)
+{
+    size_t l = 2;
+
+    b[0] = 0x1B;
+    b[1] = '[';
+    if (n != 1) l += put_uint(b + 2, n);
+    b[l++] = f;
+    return l;
+}
+
+/* put_cup ******************************************************************/
+static size_t put_cup (uint8_t * b, unsigned int row, unsigned int col)
+{
+    size_t l = 2;
+
+    b[0] = 0x1B;
+    b[1] = '[';
+    if (row != 1 || col != 1) l += put_uint(b + 2, row);
+    if (col != 1) { b[l++] = ';'; l += put_uint(b + l, col); }
+    b[l++] = 'H';
+    return l;
+}
+
+/* put_horiz ****************************************************************/
+/**
+ *  Writes the shortest move along the row from column f to column c.
+ */
+static size_t put_horiz (uint8_t * b, unsigned int f, unsigned int c)
+{
+    uint8_t t[OUT_SEQ_MAX];
+    size_t l, k;
+
+    if (f == c) return 0;
+    if (c == 1) { b[0] = '\r'; return 1; }
+    if (c > f) return put_csi(b, c - f, 'C');
+    if (f - c <= 2)
+    {
+        for (l = 0; l < f - c; ++l) b[l] = '\b';
+        return l;
+    }
+    l = put_csi(b, f - c, 'D');
+    t[0] = '\r';
+    k = 1 + put_csi(t + 1, c - 1, 'C');
+    if (k < l) { memcpy(b, t, k); l = k; }
+    k = put_csi(t, c, 'G');
+    if (k < l) { memcpy(b, t, k); l = k; }
+    return l;
+}
+
+/* out_put ******************************************************************/
+static unsigned int out_put (twx_t * twx, void const * p, size_t n)
+{
+    uint8_t * a;
+    size_t m;
+    unsigned int cs;
+
+    if (twx->out_n + n > twx->out_m)
+    {
+        for (m = twx->out_m * 2; m < twx->out_n + n; m *= 2);
+        a = hbs_realloc(twx->out_a, twx->out_m, m);
+        if (a)
+        {
+            twx->out_a = a;
+            twx->out_m = m;
+        }
+        else
+        {
+            /* short of memory the frame is sent in several writes */
+            cs = out_flush(twx);
+            if (cs) return cs;
+            if (n > twx->out_m)
+            {
+                twx->stats.out_bytes += n;
+                return twx->be->bcls->write(twx->be, p, n);
+            }
+        }
+    }
+    memcpy(twx->out_a + twx->out_n, p, n);
+    twx->out_n += n;
+    return 0;
+}
+
+/* out_flush ****************************************************************/
+unsigned int out_flush (twx_t * twx)
+{
+    size_t n = twx->out_n;
+
+    if (!n) return 0;
+    twx->out_n = 0;
+    twx->stats.out_bytes += n;
+    return twx->be->bcls->write(twx->be, twx->out_a, n);
+}
+
+/* out_begin ****************************************************************/
+unsigned int out_begin (twx_t * twx)
+{
+    unsigned int cs;
+
+#if TWX_TRACE
+    twx->trace_frame_t0 = clock_ns();
+#endif
+    cs = twx->be->bcls->write_start(twx->be);
+    if (cs) return cs;
+    twx->out_frame = 1;
+    if ((twx->caps & TWX_CAP_SYNC)) return out_put(twx, "\x1B[?2026h", 8);
+    return 0;
+}
+
+/* out_end ******************************************************************/
+unsigned int out_end (twx_t * twx)
+{
+    unsigned int cs = 0;
+
+    twx->out_frame = 0;
+    ++twx->stats.frames;
+    if ((twx->caps & TWX_CAP_SYNC)) cs = out_put(twx, "\x1B[?2026l", 8);
+    if (!cs) cs = out_flush(twx);
+    if (!cs) cs = twx->be->bcls->write_stop(twx->be);
+    TRACE(twx, TRACE_MAIN, TRACE_FRAME, twx->trace_frame_t0, clock_ns(),
+          NULL, 0, 0);
+    return cs;
+}
+
+/* out_raw ******************************************************************/
+unsigned int out_raw (twx_t * twx, void const * p, size_t n)
+{
+    twx->out_row = 0;
+    return out_put(twx, p, n);
+}
+
+/* out_move *****************************************************************/
+unsigned int out_move (twx_t * twx, unsigned int row, unsigned int col)
+{
+    uint8_t b[OUT_SEQ_MAX], t[OUT_SEQ_MAX];
+    unsigned int cs, r = twx->out_row, c = twx->out_col;
+    size_t l, k;
+
+    if (!(twx->caps & TWX_CAP_VT))
+    {
+        /* the write position of such backends is not the cursor so it is
+         * not tracked */
+        cs = out_flush(twx);
+        if (!cs) cs = twx->be->bcls->write_pos(twx->be, row, col);
+        twx->out_row = 0;
+        return cs;
+    }
+    if (r == row && c == col) return 0;
+    l = put_cup(b, row, col);
+    if (r)
+    {
+        if (row == r) k = 0;
+        else if (row > r) k = put_csi(t, row - r, 'B');
+        else k = put_csi(t, r - row, 'A');
+        k += put_horiz(t + k, c, col);
+        if (k < l) { memcpy(b, t, k); l = k; }
+        if (row == r + 1)
+        {
+            t[0] = '\r';
+            t[1] = '\n';
+            k = 2 + put_horiz(t + 2, 1, col);
+            if (k < l) { memcpy(b, t, k); l = k; }
+        }
+    }
+    twx->out_row = row;
+    twx->out_col = col;
+    return out_put(twx, b, l);
+}
+
+/* out_attr *****************************************************************/
+unsigned int out_attr (twx_t * twx, unsigned int bg, unsigned int fg,
+                       unsigned int mode)
+{
+    static uint8_t const mode_sgr[4] = { '1', '4', '5', '7' };
+    uint8_t b[40];
+    size_t l;
+    unsigned int cs, i;
+
+    if (twx->out_pen_valid && twx->out_pen.bg == bg && twx->out_pen.fg == fg
+        && twx->out_pen.mode == mode)
+        return 0;
+    if ((twx->caps & TWX_CAP_VT))
+    {
+        b[0] = 0x1B;
+        b[1] = '[';
+        b[2] = '0';
+        l = 3;
+        for (i = 0; i < 4; ++i)
+            if ((mode & (1 << i))) { b[l++] = ';'; b[l++] = mode_sgr[i]; }
+        b[l++] = ';';
+        if (fg < 8) l += put_uint(b + l, 30 + fg);
+        else if (fg < 16) l += put_uint(b + l, 90 + fg - 8);
+        else { memcpy(b + l, "38;5;", 5); l += 5 + put_uint(b + l + 5, fg); }
+        b[l++] = ';';
+        if (bg < 8) l += put_uint(b + l, 40 + bg);
+        else if (bg < 16) l += put_uint(b + l, 100 + bg - 8);
+        else { memcpy(b + l, "48;5;", 5); l += 5 + put_uint(b + l + 5, bg); }
+        b[l++] = 'm';
+        cs = out_put(twx, b, l);
+    }
+    else
+    {
+        cs = out_flush(twx);
+        if (!cs) cs = twx->be->bcls->attr(twx->be, bg, fg, mode);
+    }
+    twx->out_pen.bg = bg;
+    twx->out_pen.fg = fg;
+    twx->out_pen.mode = mode;
+    twx->out_pen_valid = !cs;
+    return cs;
+}
+
+/* out_clear ****************************************************************/
+unsigned int out_clear (twx_t * twx)
+{
+    unsigned int cs;
+
+    twx->out_row = 0;
+    if ((twx->caps & TWX_CAP_VT)) return out_put(twx, "\x1B[2J", 4);
+    cs = out_flush(twx);
+    if (cs) return cs;
+    return twx->be->bcls->clear(twx->be);
+}
+
+/* out_run ******************************************************************/
+/**
+ *  Writes n copies of a narrow char at the cursor with the pen already set,
+ *  using erase or repeat sequences when they are shorter than the chars.
+ *  Leaves the cursor before the run when it is erased.
+ */
+static unsigned int out_run (twx_t * twx, twx_cell_t const * c,
+                             unsigned int n, int * erased)
+{
+    uint8_t b[OUT_SEQ_MAX + 8], t[OUT_SEQ_MAX];
+    unsigned int l, i, cs;
+    size_t k;
+    int eol;
+
+    *erased = 0;
+    l = zlx_ucp_to_utf8_len(c->ch);
+    zlxi_ucp_to_utf8(c->ch, b);
+    if (c->ch == ' ' && !c->mode)
+    {
+        /* erased cells get the background of the pen but other modes such
+         * as reverse video would not show on them */
+        eol = twx->out_col + n > twx->fb_width;
+        k = eol ? put_csi(t, 1, 'K') : put_csi(t, n, 'X');
+        /* unless the run ends the row the cursor must then skip it */
+        if ((eol ? k : 2 * k) < n)
+        {
+            *erased = 1;
+            return out_put(twx, t, k);
+        }
+    }
+    if ((twx->caps & TWX_CAP_REP) && n > 1
+             && (k = l + put_csi(b + l, n - 1, 'b')) < (size_t) l * n)
+    {
+        twx->out_col += n;
+        return out_put(twx, b, k);
+    }
+    for (i = 0; i < n; ++i)
+    {
+        cs = out_put(twx, b, l);
+        if (cs) return cs;
+    }
+    twx->out_col += n;
+    return 0;
+}
+
+/* out_cells ****************************************************************/
+unsigned int out_cells (twx_t * twx, twx_cell_t const * c, unsigned int n)
+{
+    uint8_t b[8];
+    unsigned int i, k, l, cs, row = twx->out_row, col = twx->out_col;
+    int erased;
+
+    for (i = 0; i < n; i = k)
+    {
+        k = i + 1;
+        if (!c[i].w) continue; // right half of a wide char
+        cs = out_attr(twx, c[i].bg, c[i].fg, c[i].mode);
+        if (cs) return cs;
+        erased = 0;
+        if ((twx->caps & TWX_CAP_VT) && c[i].w == 1 && !c[i].cm)
+            for (; k < n && c[k].ch == c[i].ch && c[k].w == 1 && !c[k].cm
+                   && c[k].bg == c[i].bg && c[k].fg == c[i].fg
+                   && c[k].mode == c[i].mode; ++k);
+        if (k - i > 1)
+        {
+            cs = out_run(twx, &c[i], k - i, &erased);
+            if (!cs && erased && k < n) cs = out_move(twx, row, col + k);
+        }
+        else
+        {
+            l = zlx_ucp_to_utf8_len(c[i].ch);
+            zlxi_ucp_to_utf8(c[i].ch, b);
+            if (c[i].cm)
+            {
+                zlxi_ucp_to_utf8(c[i].cm, b + l);
+                l += zlx_ucp_to_utf8_len(c[i].cm);
+            }
+            cs = out_put(twx, b, l);
+            twx->out_col += c[i].w;
+        }
+        if (cs) return cs;
+        /* the cursor waits in the last column for the next char, where
+         * moving it relatively works differently from one terminal to
+         * another */
+        if (twx->out_col > twx->fb_width) twx->out_row = 0;
+    }
+    return 0;
+}
+
+/* out_cursor ***************************************************************/
+unsigned int out_cursor (twx_t * twx, unsigned int row, unsigned int col)
+{
+    unsigned int cs;
+
+    if ((twx->caps & TWX_CAP_VT)) return out_move(twx, row, col);
+    cs = out_flush(twx);
+    if (!cs) cs = twx->be->bcls->set_cursor_pos(twx->be, row, col);
+    twx->out_row = cs ? 0 : row;
+    twx->out_col = col;
+    return cs;
+}
+
+/* out_cursor_mode **********************************************************/
+unsigned int out_cursor_mode (twx_t * twx, unsigned int mode)
+{
+    unsigned int cs;
+
+    if (twx->out_cursor_mode == mode) return 0;
+    if ((twx->caps & TWX_CAP_VT))
+    {
+        if (twx->out_frame)
+            cs = out_put(twx, mode ? "\x1B[?25h" : "\x1B[?25l", 6);
+        else
+        {
+            cs = out_begin(twx);
+            if (!cs) cs = out_put(twx, mode ? "\x1B[?25h" : "\x1B[?25l", 6);
+            if (!cs) cs = out_end(twx);
+        }
+    }
+    else
+    {
+        cs = out_flush(twx);
+        if (!cs) cs = twx->be->bcls->set_cursor_mode(twx->be, mode);
+    }
+    twx->out_cursor_mode = cs ? TWX_CURSOR_UNKNOWN : mode;
+    return cs;
+}
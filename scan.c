@@ -0,0 +1,239 @@
+#include "intern.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#else
+#define SCAN_X86 0
+#endif
+
+static uint8_t const * ZLX_CALL scan_ctl_resolve (uint8_t const * p);
+static uint8_t const * ZLX_CALL scan_nl_resolve (uint8_t const * p,
+                                                 uint8_t const * e);
+static uint8_t const * ZLX_CALL scan_ascii_resolve (uint8_t const * p,
+                                                    uint8_t const * e);
+
+uint8_t const * (ZLX_CALL * scan_ctl) (uint8_t const * p) = scan_ctl_resolve;
+uint8_t const * (ZLX_CALL * scan_nl) (uint8_t const * p, uint8_t const * e) =
+    scan_nl_resolve;
+uint8_t const * (ZLX_CALL * scan_ascii) (uint8_t const * p,
+                                         uint8_t const * e) =
+    scan_ascii_resolve;
+
+/* scan_ctl_scalar **********************************************************/
+static uint8_t const * ZLX_CALL scan_ctl_scalar (uint8_t const * p)
+{
+    for (; *p && *p != '\n' && *p != '\a'; ++p);
+    return p;
+}
+
+/* scan_nl_scalar ***********************************************************/
+static uint8_t const * ZLX_CALL scan_nl_scalar (uint8_t const * p,
+                                                uint8_t const * e)
+{
+    return zlx_u8a_search(p, e, '\n');
+}
+
+/* scan_ascii_scalar ********************************************************/
+static uint8_t const * ZLX_CALL scan_ascii_scalar (uint8_t const * p,
+                                                   uint8_t const * e)
+{
+    for (; p < e && *p >= 0x20 && *p < 0x7F; ++p);
+    return p;
+}
+
+#if SCAN_X86
+
+/* The string scanners load whole aligned blocks, which may extend past the
+ * terminating NUL but never into another page. */
+#define SCAN_OVERREAD __attribute__((no_sanitize_address))
+
+/* scan_ctl_sse2 ************************************************************/
+__attribute__((target("sse2"))) SCAN_OVERREAD
+static uint8_t const * ZLX_CALL scan_ctl_sse2 (uint8_t const * p)
+{
+    __m128i nl = _mm_set1_epi8('\n');
+    __m128i bel = _mm_set1_epi8('\a');
+    __m128i z = _mm_setzero_si128();
+    __m128i v;
+    uint8_t const * a = (uint8_t const *) ((uintptr_t) p & ~(uintptr_t) 15);
+    unsigned int m;
+
+    v = _mm_load_si128((__m128i const *) a);
+    m = (unsigned int) _mm_movemask_epi8(
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, nl),
+                                  _mm_cmpeq_epi8(v, bel)),
+                     _mm_cmpeq_epi8(v, z)));
+    m &= 0xFFFFu << (p - a);
+    while (!m)
+    {
+        a += 16;
+        v = _mm_load_si128((__m128i const *) a);
+        m = (unsigned int) _mm_movemask_epi8(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, nl),
+                                      _mm_cmpeq_epi8(v, bel)),
+                         _mm_cmpeq_epi8(v, z)));
+    }
+    return a + __builtin_ctz(m);
+}
+
+/* scan_nl_sse2 *************************************************************/
+__attribute__((target("sse2")))
+static uint8_t const * ZLX_CALL scan_nl_sse2 (uint8_t const * p,
+                                              uint8_t const * e)
+{
+    __m128i nl = _mm_set1_epi8('\n');
+    unsigned int m;
+
+    for (; e - p >= 16; p += 16)
+    {
+        m = (unsigned int) _mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const *) p), nl));
+        if (m) return p + __builtin_ctz(m);
+    }
+    return zlx_u8a_search(p, e, '\n');
+}
+
+/* scan_ascii_sse2 **********************************************************/
+/**
+ *  Bytes 0x80 - 0xFF are negative as signed chars so they fail the lower
+ *  bound together with the controls.
+ */
+__attribute__((target("sse2")))
+static uint8_t const * ZLX_CALL scan_ascii_sse2 (uint8_t const * p,
+                                                 uint8_t const * e)
+{
+    __m128i lo = _mm_set1_epi8(0x1F);
+    __m128i hi = _mm_set1_epi8(0x7F);
+    __m128i v;
+    unsigned int m;
+
+    for (; e - p >= 16; p += 16)
+    {
+        v = _mm_loadu_si128((__m128i const *) p);
+        m = (unsigned int) _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi)));
+        if (m != 0xFFFF) return p + __builtin_ctz(~m);
+    }
+    return scan_ascii_scalar(p, e);
+}
+
+/* scan_ctl_avx2 ************************************************************/
+__attribute__((target("avx2"))) SCAN_OVERREAD
+static uint8_t const * ZLX_CALL scan_ctl_avx2 (uint8_t const * p)
+{
+    __m256i nl = _mm256_set1_epi8('\n');
+    __m256i bel = _mm256_set1_epi8('\a');
+    __m256i z = _mm256_setzero_si256();
+    __m256i v;
+    uint8_t const * a = (uint8_t const *) ((uintptr_t) p & ~(uintptr_t) 31);
+    uint32_t m;
+
+    v = _mm256_load_si256((__m256i const *) a);
+    m = (uint32_t) _mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, nl),
+                                        _mm256_cmpeq_epi8(v, bel)),
+                        _mm256_cmpeq_epi8(v, z)));
+    m &= 0xFFFFFFFFu << (p - a);
+    while (!m)
+    {
+        a += 32;
+        v = _mm256_load_si256((__m256i const *) a);
+        m = (uint32_t) _mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, nl),
+                                            _mm256_cmpeq_epi8(v, bel)),
+                            _mm256_cmpeq_epi8(v, z)));
+    }
+    return a + __builtin_ctz(m);
+}
+
+/* scan_nl_avx2 *************************************************************/
+__attribute__((target("avx2")))
+static uint8_t const * ZLX_CALL scan_nl_avx2 (uint8_t const * p,
+                                              uint8_t const * e)
+{
+    __m256i nl = _mm256_set1_epi8('\n');
+    uint32_t m;
+
+    for (; e - p >= 32; p += 32)
+    {
+        m = (uint32_t) _mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *) p), nl));
+        if (m) return p + __builtin_ctz(m);
+    }
+    return scan_nl_sse2(p, e);
+}
+
+/* scan_ascii_avx2 **********************************************************/
+__attribute__((target("avx2")))
+static uint8_t const * ZLX_CALL scan_ascii_avx2 (uint8_t const * p,
+                                                 uint8_t const * e)
+{
+    __m256i lo = _mm256_set1_epi8(0x1F);
+    __m256i hi = _mm256_set1_epi8(0x7F);
+    __m256i v;
+    uint32_t m;
+
+    for (; e - p >= 32; p += 32)
+    {
+        v = _mm256_loadu_si256((__m256i const *) p);
+        m = (uint32_t) _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpgt_epi8(v, lo),
+                             _mm256_cmpgt_epi8(hi, v)));
+        if (m != 0xFFFFFFFFu) return p + __builtin_ctz(~m);
+    }
+    return scan_ascii_sse2(p, e);
+}
+
+#endif
+
+/* scan_select **************************************************************/
+/**
+ *  Picks the best scanners supported by the processor.
+ */
+static void scan_select (void)
+{
+#if SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        scan_ctl = scan_ctl_avx2;
+        scan_nl = scan_nl_avx2;
+        scan_ascii = scan_ascii_avx2;
+        return;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        scan_ctl = scan_ctl_sse2;
+        scan_nl = scan_nl_sse2;
+        scan_ascii = scan_ascii_sse2;
+        return;
+    }
+#endif
+    scan_ctl = scan_ctl_scalar;
+    scan_nl = scan_nl_scalar;
+    scan_ascii = scan_ascii_scalar;
+}
+
+/* scan_ctl_resolve *********************************************************/
+static uint8_t const * ZLX_CALL scan_ctl_resolve (uint8_t const * p)
+{
+    scan_select();
+    return scan_ctl(p);
+}
+
+/* scan_nl_resolve **********************************************************/
+static uint8_t const * ZLX_CALL scan_nl_resolve (uint8_t const * p,
+                                                 uint8_t const * e)
+{
+    scan_select();
+    return scan_nl(p, e);
+}
+
+/* scan_ascii_resolve *******************************************************/
+static uint8_t const * ZLX_CALL scan_ascii_resolve (uint8_t const * p,
+                                                    uint8_t const * e)
+{
+    scan_select();
+    return scan_ascii(p, e);
+}
@@ -0,0 +1,242 @@
+#include <string.h>
+#include "intern.h"
+
+twx_status_t ZLX_CALL split_handler (twx_win_t * win, unsigned int evt,
+                                     twx_event_info_t * ei);
+void ZLX_CALL split_finish (twx_win_t * win);
+
+twx_win_class_t split_wcls =
+{
+    split_handler,
+    split_finish,
+    sizeof(split_win_t),
+    "twx/split"
+};
+
+/* split_finish *************************************************************/
+void ZLX_CALL split_finish (twx_win_t * win)
+{
+    split_win_t * sw = (split_win_t *) win;
+    if (sw->cm) hbs_free(sw->ca, sw->cm * sizeof(split_child_t));
+}
+
+/* split_layout *************************************************************/
+/**
+ *  Recomputes the position of the children along the split axis and sends
+ *  the new geometry to the children whose area changed.
+ */
+static twx_status_t split_layout (split_win_t * sw)
+{
+    twx_win_t * win = &sw->base;
+    split_child_t * c;
+    unsigned int total, fixed, weight, extra, cw, pos, len, i;
+    twx_status_t ts;
+
+    total = sw->dir == TWX_SPLIT_COLS ? win->width : win->height;
+    for (fixed = weight = 0, i = 0; i < sw->cn; ++i)
+    {
+        fixed += sw->ca[i].size;
+        weight += sw->ca[i].weight;
+    }
+    extra = total > fixed ? total - fixed : 0;
+
+    for (pos = cw = 0, i = 0; i < sw->cn; ++i)
+    {
+        c = &sw->ca[i];
+        len = c->size;
+        if (c->weight)
+        {
+            /* distribute the extra space by cumulative weight so that
+             * rounding never leaves cells unused */
+            len += (unsigned int) ((uint64_t) extra * (cw + c->weight) / weight
+                                   - (uint64_t) extra * cw / weight);
+            cw += c->weight;
+        }
+        if (len > total - pos) len = total - pos;
+        c->pos = pos;
+        c->len = len;
+        pos += len;
+    }
+    sw->used = pos;
+    sw->layout_valid = 1;
+
+    for (i = 0; i < sw->cn; ++i)
+    {
+        twx_win_t * cwin = sw->ca[i].win;
+        unsigned int r, k, h, w;
+        c = &sw->ca[i];
+        if (sw->dir == TWX_SPLIT_COLS)
+        {
+            r = win->scr_row;
+            k = win->scr_col + c->pos;
+            h = win->height;
+            w = c->len;
+        }
+        else
+        {
+            r = win->scr_row + c->pos;
+            k = win->scr_col;
+            h = c->len;
+            w = win->width;
+        }
+        if (cwin->scr_row == r && cwin->scr_col == k
+            && cwin->height == h && cwin->width == w) continue;
+        L("child %u: %u+%u+%ux%u", i, k, r, w, h);
+        ts = twx_win_geom(cwin, r, k, h, w);
+        if (ts) return ts;
+    }
+    return TWX_OK;
+}
+
+/* split_handler ************************************************************/
+twx_status_t ZLX_CALL split_handler (twx_win_t * win, unsigned int evt,
+                                     twx_event_info_t * ei)
+{
+    split_win_t * sw = (split_win_t *) win;
+    twx_win_t * cwin;
+    unsigned int i, top, bottom, r0, c0, r1, c1;
+    twx_status_t ts = TWX_OK;
+
+    switch (evt)
+    {
+    case TWX_GEOM:
+        if (ei->geom.scr_row != win->scr_row 
+            || ei->geom.scr_col != win->scr_col
+            || ei->geom.height != win->height 
+            || ei->geom.width != win->width)
+            sw->layout_valid = 0;
+        ts = twx_default_handler(win, evt, ei);
+        if (ts || sw->layout_valid) break;
+        ts = split_layout(sw);
+        break;
+
+    case TWX_INVALIDATE:
+        if (!sw->layout_valid && (ts = split_layout(sw))) break;
+        for (i = 0; i < sw->cn; ++i)
+        {
+            cwin = sw->ca[i].win;
+            ts = win_event(cwin, TWX_INVALIDATE, ei);
+            if (ts) break;
+        }
+        if (ts) break;
+        /* only the area not covered by children is ours to paint */
+        r0 = ei->geom.scr_row;
+        c0 = ei->geom.scr_col;
+        r1 = r0 + ei->geom.height;
+        c1 = c0 + ei->geom.width;
+        if (sw->dir == TWX_SPLIT_COLS)
+        {
+            if (c0 < win->scr_col + sw->used) c0 = win->scr_col + sw->used;
+        }
+        else if (r0 < win->scr_row + sw->used) r0 = win->scr_row + sw->used;
+        if (r0 < r1 && c0 < c1)
+            twx_win_damage(win, r0, c0, r1 - r0, c1 - c0);
+        break;
+
+    case TWX_DRAW:
+        if (!sw->layout_valid && (ts = split_layout(sw))) break;
+        for (i = 0; i < sw->cn; ++i)
+        {
+            cwin = sw->ca[i].win;
+            if (!(cwin->flags & (TWX_WF_UPDATE | TWX_WF_CONTAINER))) continue;
+            ts = win_event(cwin, TWX_DRAW, ei);
+            if (ts) break;
+        }
+        if (ts || !(win->flags & TWX_WF_UPDATE)) break;
+        /* the children have drawn already; paint only the band they
+         * leave uncovered, whatever area the clipping falls back to */
+        win_draw_begin(win, &top, &bottom);
+        if (sw->dir == TWX_SPLIT_COLS)
+        {
+            if (sw->used < win->width)
+                for (i = top; i < bottom; ++i)
+                    fb_fill(win->twx, win->scr_row + i,
+                            win->scr_col + sw->used, win->width - sw->used,
+                            ' ', sw->attr);
+        }
+        else
+        {
+            if (top < sw->used) top = sw->used;
+            for (i = top; i < bottom; ++i)
+                fb_fill(win->twx, win->scr_row + i, win->scr_col, win->width,
+                        ' ', sw->attr);
+        }
+        win_draw_end(win);
+        break;
+
+    default:
+        ts = twx_default_handler(win, evt, ei);
+    }
+
+    return ts;
+}
+
+/* twx_split_win_create *****************************************************/
+TWX_API twx_status_t ZLX_CALL twx_split_win_create
+(
+    twx_t * twx,
+    twx_win_t * * win_ptr,
+    acx1_attr_t * attr,
+    unsigned int dir
+)
+{
+    split_win_t * sw;
+
+    sw = win_alloc(twx, &split_wcls);
+    if (!sw) return TWX_NO_MEM;
+    *win_ptr = &sw->base;
+    sw->base.flags |= TWX_WF_CONTAINER;
+    sw->attr = attr;
+    sw->dir = dir;
+    return TWX_OK;
+}
+
+/* twx_split_win_add ********************************************************/
+TWX_API twx_status_t ZLX_CALL twx_split_win_add
+(
+    twx_win_t * win,
+    twx_win_t * child,
+    unsigned int size,
+    unsigned int weight
+)
+{
+    split_win_t * sw = (split_win_t *) win;
+    split_child_t * ca;
+    size_t m;
+
+    if (sw->cn == sw->cm)
+    {
+        m = (sw->cm + 4) & ~(size_t) 3;
+        ca = hbs_realloc(sw->ca, sw->cm * sizeof(split_child_t),
+                         m * sizeof(split_child_t));
+        if (!ca) return TWX_NO_MEM;
+        sw->ca = ca;
+        sw->cm = m;
+    }
+    ca = &sw->ca[sw->cn++];
+    memset(ca, 0, sizeof(*ca));
+    ca->win = child;
+    ca->size = size;
+    ca->weight = weight;
+    sw->layout_valid = 0;
+    return twx_win_refresh(win);
+}
+
+/* twx_split_win_remove *****************************************************/
+TWX_API twx_status_t ZLX_CALL twx_split_win_remove
+(
+    twx_win_t * win,
+    twx_win_t * child
+)
+{
+    split_win_t * sw = (split_win_t *) win;
+    size_t i;
+
+    for (i = 0; i < sw->cn && sw->ca[i].win != child; ++i);
+    if (i == sw->cn) return TWX_OK;
+    memmove(sw->ca + i, sw->ca + i + 1,
+            (sw->cn - i - 1) * sizeof(split_child_t));
+    sw->cn--;
+    sw->layout_valid = 0;
+    return twx_win_refresh(win);
+}
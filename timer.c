@@ -0,0 +1,274 @@
+#include "intern.h"
+
+#define TIMER_SLOTS (1 << TWX_TIMER_BITS)
+#define TIMER_MASK (TIMER_SLOTS - 1)
+#define TIMER_NONE UINT64_MAX
+#define TIMER_FIRING 0xFFFF // twx_timer_t.slot while in timer_fire
+
+/* link_add *****************************************************************/
+ZLX_INLINE void link_add (timer_link_t * h, timer_link_t * l)
+{
+    l->prev = h->prev;
+    l->next = h;
+    h->prev->next = l;
+    h->prev = l;
+}
+
+/* link_del *****************************************************************/
+ZLX_INLINE void link_del (timer_link_t * l)
+{
+    l->prev->next = l->next;
+    l->next->prev = l->prev;
+}
+
+/* wheel_add ****************************************************************/
+/**
+ *  Puts a timer on the lowest level of the wheel whose slots reach its
+ *  deadline; the top level holds the timers past its reach in its last
+ *  slot, from which they are put back on the wheel when it comes up.
+ */
+static void wheel_add (twx_t * twx, twx_timer_t * t)
+{
+    uint64_t due, now = twx->timer_tick, b;
+    unsigned int l, sh = 0;
+
+    due = (t->due + TWX_TIMER_TICK_US - 1) / TWX_TIMER_TICK_US;
+    if (due < now) due = now;
+    for (l = 0; l < TWX_TIMER_LEVELS - 1; ++l, sh += TWX_TIMER_BITS)
+        if ((due >> sh) - (now >> sh) < TIMER_SLOTS) break;
+    b = due >> sh;
+    if (b - (now >> sh) >= TIMER_SLOTS) b = (now >> sh) + TIMER_MASK;
+    t->slot = (uint16_t) ((l << TWX_TIMER_BITS) | (b & TIMER_MASK));
+    link_add(&twx->timer_slot[l][b & TIMER_MASK], &t->link);
+    twx->timer_map[l] |= (uint64_t) 1 << (b & TIMER_MASK);
+}
+
+/* wheel_del ****************************************************************/
+static void wheel_del (twx_t * twx, twx_timer_t * t)
+{
+    unsigned int l = t->slot >> TWX_TIMER_BITS, s = t->slot & TIMER_MASK;
+
+    link_del(&t->link);
+    if (twx->timer_slot[l][s].next == &twx->timer_slot[l][s])
+        twx->timer_map[l] &= ~((uint64_t) 1 << s);
+}
+
+/* wheel_next ***************************************************************/
+/**
+ *  Returns the next tick when the wheel has timers to fire or to move to
+ *  a lower level, or TIMER_NONE.
+ */
+static uint64_t wheel_next (twx_t * twx)
+{
+    uint64_t best = TIMER_NONE, m, b, t;
+    unsigned int l, sh, o;
+
+    for (l = 0, sh = 0; l < TWX_TIMER_LEVELS; ++l, sh += TWX_TIMER_BITS)
+    {
+        m = twx->timer_map[l];
+        if (!m) continue;
+        b = twx->timer_tick >> sh;
+        /* rotate the slot map so that the slot of tick comes first */
+        o = b & TIMER_MASK;
+        if (o) m = (m >> o) | (m << (TIMER_SLOTS - o));
+        t = (b + __builtin_ctzll(m)) << sh;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+/* wheel_expire *************************************************************/
+/**
+ *  Advances the wheel to the given tick and moves the expired timers to
+ *  the timer_fire list.
+ */
+static void wheel_expire (twx_t * twx, uint64_t tick)
+{
+    timer_link_t * h;
+    twx_timer_t * t;
+    uint64_t n;
+    unsigned int l, s;
+
+    while ((n = wheel_next(twx)) <= tick)
+    {
+        twx->timer_tick = n;
+        /* timers due in the block that starts now go down a level */
+        for (l = TWX_TIMER_LEVELS - 1; l; --l)
+        {
+            s = (n >> (l * TWX_TIMER_BITS)) & TIMER_MASK;
+            h = &twx->timer_slot[l][s];
+            twx->timer_map[l] &= ~((uint64_t) 1 << s);
+            while (h->next != h)
+            {
+                t = (twx_timer_t *) h->next;
+                link_del(&t->link);
+                wheel_add(twx, t);
+            }
+        }
+        s = n & TIMER_MASK;
+        h = &twx->timer_slot[0][s];
+        twx->timer_map[0] &= ~((uint64_t) 1 << s);
+        while (h->next != h)
+        {
+            t = (twx_timer_t *) h->next;
+            link_del(&t->link);
+            t->slot = TIMER_FIRING;
+            link_add(&twx->timer_fire, &t->link);
+        }
+    }
+    if (twx->timer_tick < tick) twx->timer_tick = tick;
+}
+
+/* timer_find ***************************************************************/
+/**
+ *  Finds the timer of a window with the given id in the short list of the
+ *  timers of the window.
+ */
+static twx_timer_t * timer_find (twx_win_t * win, unsigned int id)
+{
+    twx_timer_t * t;
+
+    for (t = win->timers; t && t->id != id; t = t->wnext);
+    return t;
+}
+
+/* timer_remove *************************************************************/
+static void timer_remove (twx_t * twx, twx_timer_t * t)
+{
+    if (t->slot == TIMER_FIRING) link_del(&t->link);
+    else wheel_del(twx, t);
+    *t->wprev = t->wnext;
+    if (t->wnext) t->wnext->wprev = t->wprev;
+    --twx->timer_n;
+    hbs_free(t, sizeof(twx_timer_t));
+}
+
+/* timer_init ***************************************************************/
+void timer_init (twx_t * twx)
+{
+    unsigned int l, s;
+
+    for (l = 0; l < TWX_TIMER_LEVELS; ++l)
+        for (s = 0; s < TIMER_SLOTS; ++s)
+            twx->timer_slot[l][s].next = twx->timer_slot[l][s].prev =
+                &twx->timer_slot[l][s];
+    twx->timer_fire.next = twx->timer_fire.prev = &twx->timer_fire;
+    twx->timer_tick = clock_us() / TWX_TIMER_TICK_US;
+}
+
+/* timer_free ***************************************************************/
+void timer_free (twx_t * twx)
+{
+    unsigned int l, s;
+
+    for (l = 0; l < TWX_TIMER_LEVELS; ++l)
+        for (s = 0; s < TIMER_SLOTS; ++s)
+            while (twx->timer_slot[l][s].next != &twx->timer_slot[l][s])
+                timer_remove(twx, (twx_timer_t *) twx->timer_slot[l][s].next);
+    while (twx->timer_fire.next != &twx->timer_fire)
+        timer_remove(twx, (twx_timer_t *) twx->timer_fire.next);
+}
+
+/* timer_stop_win ***********************************************************/
+void timer_stop_win (twx_win_t * win)
+{
+    while (win->timers) timer_remove(win->twx, win->timers);
+}
+
+/* timer_next ***************************************************************/
+uint64_t timer_next (twx_t * twx)
+{
+    uint64_t n;
+
+    if (!twx->timer_n) return 0;
+    n = wheel_next(twx);
+    return n == TIMER_NONE ? 0 : n * TWX_TIMER_TICK_US;
+}
+
+/* timer_due ****************************************************************/
+int timer_due (twx_t * twx, uint64_t now)
+{
+    uint64_t n = timer_next(twx);
+
+    return n && n <= now;
+}
+
+/* timer_run ****************************************************************/
+unsigned int timer_run (twx_t * twx, twx_status_t * ts_ptr)
+{
+    twx_event_info_t ei;
+    twx_timer_t * t;
+    twx_win_t * win;
+    uint64_t now;
+    unsigned int n = 0;
+
+    if (!twx->timer_n) return 0;
+    now = clock_us();
+    wheel_expire(twx, now / TWX_TIMER_TICK_US);
+    while (twx->timer_fire.next != &twx->timer_fire)
+    {
+        t = (twx_timer_t *) twx->timer_fire.next;
+        /* set it again before the handler, which may stop it */
+        link_del(&t->link);
+        t->due += t->interval;
+        if (t->due <= now) t->due = now + t->interval; // skip missed ticks
+        wheel_add(twx, t);
+        win = t->win;
+        ei.id = t->id;
+        ++n;
+        *ts_ptr = win_event(win, TWX_TIMER, &ei);
+        if (*ts_ptr) break;
+    }
+    return n;
+}
+
+/* twx_timer_start **********************************************************/
+TWX_API twx_status_t ZLX_CALL twx_timer_start
+(
+    twx_win_t * win,
+    unsigned int usec,
+    unsigned int id
+)
+{
+    twx_t * twx = win->twx;
+    twx_timer_t * t;
+    uint64_t now = clock_us();
+
+    t = timer_find(win, id);
+    if (t)
+    {
+        if (t->slot == TIMER_FIRING) link_del(&t->link);
+        else wheel_del(twx, t);
+    }
+    else
+    {
+        t = hbs_alloc(sizeof(twx_timer_t), "twx.timer");
+        if (!t) return TWX_NO_MEM;
+        t->win = win;
+        t->id = id;
+        t->wnext = win->timers;
+        t->wprev = &win->timers;
+        if (t->wnext) t->wnext->wprev = &t->wnext;
+        win->timers = t;
+        /* an idle wheel may lag behind; it has nothing to fire on the way */
+        if (!twx->timer_n++) twx->timer_tick = now / TWX_TIMER_TICK_US;
+    }
+    if (usec < TWX_TIMER_TICK_US) usec = TWX_TIMER_TICK_US;
+    t->interval = usec;
+    t->due = now + usec;
+    wheel_add(twx, t);
+    return TWX_OK;
+}
+
+/* twx_timer_stop ***********************************************************/
+TWX_API void ZLX_CALL twx_timer_stop
+(
+    twx_win_t * win,
+    unsigned int id
+)
+{
+    twx_timer_t * t;
+
+    t = timer_find(win, id);
+    if (t) timer_remove(win->twx, t);
+}
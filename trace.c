@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include "intern.h"
+
+#if TWX_TRACE
+
+#define TRACE_RING_SIZE ((size_t) 1 << TWX_TRACE_RING_POWER)
+
+static char const * const trace_thread_names[TRACE_THREADS] =
+{
+    "twx_run",
+    "input_processor",
+};
+
+/* trace_init ***************************************************************/
+twx_status_t trace_init (twx_t * twx)
+{
+    unsigned int i;
+
+    for (i = 0; i < TRACE_THREADS; ++i)
+    {
+        twx->trace_a[i].a = hbs_alloc(TRACE_RING_SIZE * sizeof(trace_rec_t),
+                                      "twx.trace");
+        if (!twx->trace_a[i].a) return TWX_NO_MEM;
+        twx->trace_a[i].n = 0;
+    }
+    return TWX_OK;
+}
+
+/* trace_free ***************************************************************/
+void trace_free (twx_t * twx)
+{
+    unsigned int i;
+
+    for (i = 0; i < TRACE_THREADS; ++i)
+        if (twx->trace_a[i].a)
+            hbs_free(twx->trace_a[i].a,
+                     TRACE_RING_SIZE * sizeof(trace_rec_t));
+}
+
+/* trace_add ****************************************************************/
+void trace_add (twx_t * twx, unsigned int thread, unsigned int kind,
+                uint64_t t0, uint64_t t1, void const * p, uint32_t arg,
+                uint32_t id)
+{
+    trace_ring_t * tr = &twx->trace_a[thread];
+    size_t n;
+    trace_rec_t * r;
+
+    /* a second writer would lose or tear records of the single-writer
+     * ring */
+    if (thread == TRACE_MAIN && ui_twx != twx) return;
+    n = tr->n;
+    r = &tr->a[n & (TRACE_RING_SIZE - 1)];
+    r->t0 = t0;
+    r->t1 = t1;
+    r->p = p;
+    r->arg = arg;
+    r->id = id;
+    r->kind = kind;
+    ATOMIC_STORE(&tr->n, n + 1);
+}
+
+/* dump_rec *****************************************************************/
+/**
+ *  Writes the Chrome trace events for one record.
+ */
+static void dump_rec (FILE * f, trace_rec_t const * r, unsigned int tid,
+                      int * first)
+{
+    char const * sep = *first ? "\n" : ",\n";
+
+    *first = 0;
+    switch (r->kind)
+    {
+    case TRACE_HANDLER:
+        fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                sep, twx_event_name(r->arg), (char const *) r->p,
+                r->t0 / 1e3, (r->t1 - r->t0) / 1e3, tid);
+        break;
+    case TRACE_FRAME:
+    case TRACE_READ_EVENT:
+        fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"twx\",\"ph\":\"X\","
+                "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                sep, r->kind == TRACE_FRAME ? "frame" : "read_event",
+                r->t0 / 1e3, (r->t1 - r->t0) / 1e3, tid);
+        break;
+    case TRACE_KEY_IN:
+        /* the flow links the key to the handler call that takes it */
+        fprintf(f, "%s{\"name\":\"key\",\"cat\":\"key\",\"ph\":\"i\","
+                "\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"km\":\"0x%X\"}},\n"
+                "{\"name\":\"key\",\"cat\":\"key\",\"ph\":\"s\","
+                "\"id\":%u,\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                sep, r->t0 / 1e3, tid, r->arg, r->id, r->t0 / 1e3, tid);
+        break;
+    case TRACE_KEY_OUT:
+        fprintf(f, "%s{\"name\":\"key\",\"cat\":\"key\",\"ph\":\"f\","
+                "\"id\":%u,\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                sep, r->id, r->t0 / 1e3, tid);
+        break;
+    }
+}
+
+#endif
+
+/* twx_trace_dump ***********************************************************/
+TWX_API twx_status_t ZLX_CALL twx_trace_dump
+(
+    twx_t * twx,
+    char const * path
+)
+{
+#if TWX_TRACE
+    FILE * f;
+    trace_ring_t * tr;
+    trace_rec_t r;
+    size_t b, e, i;
+    unsigned int t;
+    int first = 1;
+
+    f = fopen(path, "w");
+    if (!f) return TWX_FILE_ERROR;
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (t = 0; t < TRACE_THREADS; ++t)
+    {
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "\n" : ",\n", t + 1, trace_thread_names[t]);
+        first = 0;
+        tr = &twx->trace_a[t];
+        e = ATOMIC_LOAD(&tr->n);
+        b = e > TRACE_RING_SIZE ? e - TRACE_RING_SIZE : 0;
+        for (i = b; i < e; ++i)
+        {
+            r = tr->a[i & (TRACE_RING_SIZE - 1)];
+            ATOMIC_FENCE();
+            /* skip the record if the writer got around to its slot */
+            if (ATOMIC_LOAD(&tr->n) > i + TRACE_RING_SIZE - 1) continue;
+            dump_rec(f, &r, t + 1, &first);
+        }
+    }
+    fprintf(f, "\n]}\n");
+    if (fclose(f)) return TWX_FILE_ERROR;
+    return TWX_OK;
+#else
+    (void) twx, (void) path;
+    return TWX_NO_TRACE;
+#endif
+}
@@ -27,6 +27,10 @@ TWX_API char * ZLX_CALL twx_event_name (unsigned int evt)
         X(TWX_KEY);
         X(TWX_ITXT_ENTERED);
         X(TWX_ITXT_CANCELLED);
+        X(TWX_KEYS);
+        X(TWX_FVIEW_PROGRESS);
+        X(TWX_PASTE);
+        X(TWX_TIMER);
 #undef X
     }
     return "<twx-unknown-evt>";
@@ -39,28 +43,142 @@ TWX_API void ZLX_CALL twx_shutdown
     twx_status_t exit_status
 )
 {
-    hbs_mutex_lock(twx->main_mutex);
+    tcond_lock(twx->main);
     twx->exit_status = exit_status;
     twx->shutdown = 1;
-    hbs_mutex_unlock(twx->main_mutex);
-    hbs_cond_signal(twx->main_cond);
+    tcond_unlock(twx->main);
+    tcond_signal(twx->main);
 }
 
+/* wake_main ****************************************************************/
+void wake_main (twx_t * twx)
+{
+    ATOMIC_FENCE();
+    if (!ATOMIC_LOAD(&twx->main_waiting)) return;
+    tcond_lock(twx->main);
+    tcond_unlock(twx->main);
+    tcond_signal(twx->main);
+}
+
+/* queue_room ***************************************************************/
+/**
+ *  Waits for room in the key ring, which twx_run() makes as it takes keys.
+ *  Input is not read meanwhile, so it backs up in the terminal instead of
+ *  being lost.
+ *  @returns 0 on success, 1 if twx is shutting down with the ring full
+ */
+static int queue_room (twx_t * twx)
+{
+    while (((twx->kre + 1) & twx->krm) == ATOMIC_LOAD(&twx->krb))
+    {
+        if (ATOMIC_LOAD(&twx->shutdown))
+        {
+            ++twx->stats.keys_dropped;
+            return 1;
+        }
+        clock_nap(TWX_KEY_RING_WAIT_US);
+    }
+    return 0;
+}
+
+/* queue_key ****************************************************************/
+/**
+ *  Appends a key to the key ring, waiting for room if it is full.
+ *  @returns 0 on success, 1 if the key was dropped on shutdown
+ */
+static int queue_key (twx_t * twx, uint32_t km)
+{
+    unsigned int ke;
+
+    if (queue_room(twx)) return 1;
+    ke = twx->kre;
+    TRACE(twx, TRACE_INPUT, TRACE_KEY_IN, clock_ns(), 0, NULL, km,
+          twx->trace_key_in++);
+    twx->key_ring[ke] = km;
+    ATOMIC_STORE(&twx->kre, (ke + 1) & twx->krm);
+    wake_main(twx);
+    return 0;
+}
+
+/* paste_free ***************************************************************/
+static void paste_free (twx_paste_t * pst)
+{
+    hbs_free(pst, sizeof(twx_paste_t) + pst->alloc);
+}
+
+#if TWX_BRACKETED_PASTE
+/* paste_add ****************************************************************/
+/**
+ *  Appends the UTF-8 text of a pasted key, growing the paste buffer as
+ *  needed; keys that stand for no text are dropped.
+ */
+static twx_status_t paste_add (twx_paste_t * * pst_ptr, uint32_t km)
+{
+    twx_paste_t * pst = *pst_ptr;
+    uint32_t ucp = km & ~ACX1_ALT;
+    size_t m;
+
+    if (ucp >= 0x110000) return TWX_OK;
+    if (pst->alloc - pst->size < 5)
+    {
+        m = pst->alloc * 2;
+        pst = hbs_realloc(pst, sizeof(twx_paste_t) + pst->alloc,
+                          sizeof(twx_paste_t) + m);
+        if (!pst) return TWX_NO_MEM;
+        pst->alloc = m;
+        *pst_ptr = pst;
+    }
+    if ((km & ACX1_ALT)) pst->data[pst->size++] = ACX1_ESC;
+    zlxi_ucp_to_utf8(ucp, pst->data + pst->size);
+    pst->size += zlx_ucp_to_utf8_len(ucp);
+    return TWX_OK;
+}
+
+/* paste_queue **************************************************************/
+/**
+ *  Hands a finished paste over to twx_run(), keeping its place among the
+ *  keys with a TWX_KEY_PASTE in the key ring.
+ */
+static void paste_queue (twx_t * twx, twx_paste_t * pst)
+{
+    if (queue_room(twx))
+    {
+        L("shutting down; dropping paste of %lu bytes",
+          (unsigned long) pst->size);
+        paste_free(pst);
+        return;
+    }
+    pst->next = NULL;
+    tcond_lock(twx->main);
+    if (twx->paste_tail) twx->paste_tail->next = pst;
+    else twx->paste_head = pst;
+    twx->paste_tail = pst;
+    tcond_unlock(twx->main);
+    queue_key(twx, TWX_KEY_PASTE);
+}
+#endif
+
 /* input_processor **********************************************************/
 static uint8_t ZLX_CALL input_processor (void * arg)
 {
     twx_t * twx = arg;
+    twx_backend_t * be = twx->be;
     unsigned int cs;
     acx1_event_t e;
+#if TWX_BRACKETED_PASTE
+    twx_paste_t * pst = NULL; // paste being collected
+#endif
+    uint64_t t;
 
     while (!twx->shutdown)
     {
         L("waiting for event...");
-        cs = acx1_read_event(&e);
+        t = TRACE_NOW();
+        cs = be->bcls->read_event(be, &e);
         L("got event %u", e.type);
         if (cs)
         {
-            L("acx1_read_event() error %u", cs);
+            L("read_event() error %u", cs);
             twx_shutdown(twx, TWX_CONSOLE_INPUT_ERROR);
             break;
         }
@@ -68,28 +186,42 @@ static uint8_t ZLX_CALL input_processor (void * arg)
         {
         case ACX1_RESIZE:
             L("signalling resize to %ux%u", e.size.w, e.size.h);
-            hbs_mutex_lock(twx->main_mutex);
+            tcond_lock(twx->main);
             twx->screen_resized = 1;
             twx->height = e.size.h;
             twx->width = e.size.w;
-            hbs_mutex_unlock(twx->main_mutex);
-            hbs_cond_signal(twx->main_cond);
+            tcond_unlock(twx->main);
+            tcond_signal(twx->main);
             break;
         case ACX1_KEY:
+#if TWX_BRACKETED_PASTE
+            if (e.km == ACX1_PASTE_BEGIN)
+            {
+                if (pst) break;
+                pst = hbs_alloc(sizeof(twx_paste_t) + 0x1000, "twx.paste");
+                if (pst) { pst->size = 0; pst->alloc = 0x1000; }
+                else L("no mem for paste");
+                break;
+            }
+            if (e.km == ACX1_PASTE_END)
+            {
+                if (pst) paste_queue(twx, pst);
+                pst = NULL;
+                break;
+            }
+            if (pst)
             {
-                unsigned int sig;
-                L("signalling key 0x%X", e.km);
-                hbs_mutex_lock(twx->main_mutex);
-                if (((twx->kre + 1) & twx->krm) != twx->krb)
+                if (paste_add(&pst, e.km))
                 {
-                    twx->key_ring[twx->kre++] = e.km;
-                    twx->kre &= twx->krm;
-                    sig = 1;
+                    L("no mem for paste; dropping it");
+                    paste_free(pst);
+                    pst = NULL;
                 }
-                else sig = 0;
-                hbs_mutex_unlock(twx->main_mutex);
-                if (sig) hbs_cond_signal(twx->main_cond);
+                break;
             }
+#endif
+            L("signalling key 0x%X", e.km);
+            queue_key(twx, e.km);
             break;
         case ACX1_FINISH:
             break;
@@ -97,7 +229,13 @@ static uint8_t ZLX_CALL input_processor (void * arg)
             L("unhandled event %u", e.type);
             twx_shutdown(twx, TWX_CONSOLE_INPUT_ERROR);
         }
+        TRACE(twx, TRACE_INPUT, TRACE_READ_EVENT, t, clock_ns(), NULL,
+              e.type, 0);
     }
+    (void) t;
+#if TWX_BRACKETED_PASTE
+    if (pst) paste_free(pst);
+#endif
     return 0;
 }
 
@@ -106,12 +244,23 @@ TWX_API twx_status_t ZLX_CALL twx_create
 (
     twx_t * * twx_ptr
 )
+{
+    return twx_create_on(twx_ptr, &console_backend);
+}
+
+/* twx_create_on ************************************************************/
+TWX_API twx_status_t ZLX_CALL twx_create_on
+(
+    twx_t * * twx_ptr,
+    twx_backend_t * be
+)
 {
     twx_t * twx;
     unsigned int cs;
     zlx_mth_status_t ths;
     twx_status_t ts = TWX_BUG;
     uint16_t h, w;
+    size_t i;
 
     hbs_init();
     twx = hbs_alloc(sizeof(twx_t), "twx");
@@ -121,6 +270,9 @@ TWX_API twx_status_t ZLX_CALL twx_create
     do
     {
         memset(twx, 0, sizeof(*twx));
+        twx->be = be;
+        twx->out_cursor_mode = TWX_CURSOR_UNKNOWN;
+        timer_init(twx);
         twx->krm = (1 << TWX_KEY_RING_POWER) - 1;
         L("krm=%u", (int) twx->krm);
         twx->key_ring = hbs_alloc(sizeof(uint32_t) * (twx->krm + 1), 
@@ -132,34 +284,48 @@ TWX_API twx_status_t ZLX_CALL twx_create
             break;
         }
 
-        twx->main_mutex = hbs_mutex_create("twx.mutex.main");
-        if (!twx->main_mutex)
+        twx->out_m = TWX_OUT_SIZE;
+        twx->out_a = hbs_alloc(twx->out_m, "twx.out");
+        if (!twx->out_a)
         {
-            L("ouch");
             ts = TWX_NO_MEM;
             break;
         }
-        twx->init_state |= TWX_INITED_MUTEX;
 
-        twx->main_cond = hbs_cond_create(&ths, "twx.cond.main");
-        if (!twx->main_cond)
+        twx->prm = ((size_t) 1 << TWX_POST_RING_POWER) - 1;
+        twx->post_ring = hbs_alloc(sizeof(twx_post_t) * (twx->prm + 1),
+                                   "twx.post_ring");
+        if (!twx->post_ring)
         {
-            L("ouch: %u", ths);
-            ts = ths == ZLX_MTH_NO_MEM ? TWX_NO_MEM : TWX_MAIN_COND_INIT_FAILED;
+            ts = TWX_NO_MEM;
             break;
         }
-        twx->init_state |= TWX_INITED_COND;
+        for (i = 0; i <= twx->prm; ++i) twx->post_ring[i].seq = i;
+
+#if TWX_TRACE
+        ts = trace_init(twx);
+        if (ts) break;
+#endif
 
-        cs = acx1_init();
+        ts = tcond_create(&twx->main);
+        if (ts)
+        {
+            L("ouch: %u", ts);
+            break;
+        }
+        twx->init_state |= TWX_INITED_MAIN;
+        twx->frame_interval = TWX_FRAME_INTERVAL_DEFAULT;
+
+        cs = be->bcls->init(be);
         if (cs)
         {
-            L("acx1_init() error %u", cs);
+            L("%s init error %u", be->bcls->name, cs);
             ts = TWX_CONSOLE_INIT_ERROR;
             break;
         }
         twx->init_state |= TWX_INITED_CONSOLE;
 
-        cs = acx1_get_screen_size(&h, &w);
+        cs = be->bcls->get_screen_size(be, &h, &w);
         if (cs)
         {
             L("failed to get screen size (%u)", cs);
@@ -169,6 +335,7 @@ TWX_API twx_status_t ZLX_CALL twx_create
         twx->height = h;
         twx->width = w;
         twx->screen_resized = 1;
+        twx->caps = be->caps;
 
         ths = hbs_thread_create(&twx->input_thread, input_processor, twx);
         if (ths)
@@ -177,6 +344,7 @@ TWX_API twx_status_t ZLX_CALL twx_create
             ts = TWX_THREAD_CREATE_FAILED;
             break;
         }
+        twx->init_state |= TWX_INITED_INPUT;
 
         twx->root_win = NULL;
         twx->focus_win = NULL;
@@ -202,16 +370,29 @@ TWX_API void ZLX_CALL twx_destroy
 )
 {
     twx->shutdown = 1;
-    if ((twx->init_state & TWX_INITED_COND))
-        hbs_cond_destroy(twx->main_cond);
-    if ((twx->init_state & TWX_INITED_MUTEX))
-        hbs_mutex_destroy(twx->main_mutex);
+    /* the input thread uses the mutex and the condition */
     if ((twx->init_state & TWX_INITED_CONSOLE))
-        acx1_finish();
+        twx->be->bcls->finish(twx->be);
     if ((twx->init_state & TWX_INITED_INPUT))
         hbs_thread_join(twx->input_thread, NULL);
+    if ((twx->init_state & TWX_INITED_MAIN))
+        tcond_destroy(twx->main);
     if ((twx->init_state & TWX_INITED_KEY_RING))
         hbs_free(twx->key_ring, sizeof(uint32_t) * (twx->krm + 1));
+    if (twx->post_ring)
+        hbs_free(twx->post_ring, sizeof(twx_post_t) * (twx->prm + 1));
+    if (twx->out_a) hbs_free(twx->out_a, twx->out_m);
+    while (twx->paste_head)
+    {
+        twx_paste_t * pst = twx->paste_head;
+        twx->paste_head = pst->next;
+        paste_free(pst);
+    }
+    fb_free(twx);
+    timer_free(twx);
+#if TWX_TRACE
+    trace_free(twx);
+#endif
     hbs_free(twx, sizeof(twx_t));
 }
 
@@ -221,12 +402,17 @@ TWX_API void ZLX_CALL twx_refresh
     twx_t * twx
 )
 {
-    unsigned int sig;
-    hbs_mutex_lock(twx->main_mutex);
-    sig = (twx->draw_mode == 0);
-    if (sig) twx->draw_mode = TWX_DRAW;
-    hbs_mutex_unlock(twx->main_mutex);
-    if (sig) hbs_cond_signal(twx->main_cond);
+    if (!ATOMIC_XCHG(&twx->draw_mode, TWX_DRAW)) wake_main(twx);
+}
+
+/* twx_set_frame_interval ***************************************************/
+TWX_API void ZLX_CALL twx_set_frame_interval
+(
+    twx_t * twx,
+    unsigned int usec
+)
+{
+    ATOMIC_STORE(&twx->frame_interval, usec);
 }
 
 /* twx_set_root *************************************************************/
@@ -236,11 +422,11 @@ TWX_API void ZLX_CALL twx_set_root
 )
 {
     twx_t * twx = win->twx;
-    hbs_mutex_lock(twx->main_mutex);
+    tcond_lock(twx->main);
     twx->root_win = win;
     twx->screen_resized = 1;
-    hbs_mutex_unlock(twx->main_mutex);
-    hbs_cond_signal(twx->main_cond);
+    tcond_unlock(twx->main);
+    tcond_signal(twx->main);
 }
 
 /* twx_post_win_focus *******************************************************/
@@ -251,9 +437,44 @@ TWX_API void ZLX_CALL twx_post_win_focus
 {
     twx_t * twx = win->twx;
     L("posting focus to %s:%p", win->wcls->name, win);
-    hbs_mutex_lock(twx->main_mutex);
+    tcond_lock(twx->main);
     twx->new_focus_win = win;
-    hbs_mutex_unlock(twx->main_mutex);
+    tcond_unlock(twx->main);
+}
+
+/* twx_post_event ***********************************************************/
+TWX_API twx_status_t ZLX_CALL twx_post_event
+(
+    twx_win_t * win,
+    unsigned int evt,
+    twx_event_info_t const * ei
+)
+{
+    twx_t * twx = win->twx;
+    twx_post_t * p;
+    size_t e, seq;
+
+    /* claim the slot at the ring end: one whose seq says it is free for
+     * this lap; a slot still one lap behind means the ring is full */
+    e = ATOMIC_LOAD(&twx->pre);
+    for (;;)
+    {
+        p = &twx->post_ring[e & twx->prm];
+        seq = ATOMIC_LOAD(&p->seq);
+        if (seq == e)
+        {
+            if (ATOMIC_CAS(&twx->pre, &e, e + 1)) break;
+        }
+        else if ((ptrdiff_t) (seq - e) < 0) return TWX_QUEUE_FULL;
+        else e = ATOMIC_LOAD(&twx->pre);
+    }
+    p->win = win;
+    p->evt = evt;
+    if (ei) p->ei = *ei;
+    else memset(&p->ei, 0, sizeof(p->ei));
+    ATOMIC_STORE(&p->seq, e + 1);
+    wake_main(twx);
+    return TWX_OK;
 }
 
 /* twx_win_focus ************************************************************/
@@ -269,19 +490,79 @@ TWX_API twx_status_t ZLX_CALL twx_win_focus
     if (owin)
     {
         L("unfocusing win=%s:%p...", owin->wcls->name, owin);
-        ts = owin->wcls->handler(owin, TWX_UNFOCUS, NULL);
+        ts = win_event(owin, TWX_UNFOCUS, NULL);
         if (ts) { L("ouch %u", ts); return ts; }
     }
     twx->new_focus_win = twx->focus_win = win;
     if (win)
     {
         L("focusing win=%s:%p...", win->wcls->name, win);
-        ts = win->wcls->handler(win, TWX_FOCUS, NULL);
+        ts = win_event(win, TWX_FOCUS, NULL);
         if (ts) { L("ouch %u", ts); return ts; }
     }
     return TWX_OK;
 }
 
+/* draw_due *****************************************************************/
+/**
+ *  Tells whether a requested draw can be done now.
+ *  Unless drawing is urgent, draws are spaced by at least frame_interval.
+ */
+static int draw_due (twx_t * twx, uint64_t now)
+{
+    return twx->draw_now
+        || now - twx->frame_us >= ATOMIC_LOAD(&twx->frame_interval);
+}
+
+/* main_pending *************************************************************/
+/**
+ *  Tells whether twx_run() has any work to do.
+ */
+static int main_pending (twx_t * twx)
+{
+    return ATOMIC_LOAD(&twx->shutdown)
+        || ATOMIC_LOAD(&twx->screen_resized)
+        || (ATOMIC_LOAD(&twx->draw_mode) && draw_due(twx, clock_us()))
+        || ATOMIC_LOAD(&twx->new_focus_win) != twx->focus_win
+        || ATOMIC_LOAD(&twx->kre) != twx->krb
+        || ATOMIC_LOAD(&twx->post_ring[twx->prb & twx->prm].seq)
+            == twx->prb + 1
+        || timer_due(twx, clock_us());
+}
+
+/* run_posted ***************************************************************/
+/**
+ *  Delivers up to TWX_POST_BATCH events posted by other threads.
+ *  @returns the number of events delivered
+ */
+static unsigned int run_posted (twx_t * twx, twx_status_t * ts_ptr)
+{
+    twx_post_t * p;
+    twx_win_t * win;
+    twx_event_info_t ei;
+    unsigned int evt, n;
+    size_t b;
+
+    for (n = 0; n < TWX_POST_BATCH;)
+    {
+        b = twx->prb;
+        p = &twx->post_ring[b & twx->prm];
+        if (ATOMIC_LOAD(&p->seq) != b + 1) break;
+        win = p->win;
+        evt = p->evt;
+        ei = p->ei;
+        /* hand the slot back to producers before running the handler */
+        ATOMIC_STORE(&p->seq, b + twx->prm + 1);
+        twx->prb = b + 1;
+        ++n;
+        if (!win) continue; // the window was destroyed
+        L("posted %s for win=%p", twx_event_name(evt), win);
+        *ts_ptr = win_event(win, evt, &ei);
+        if (*ts_ptr) break;
+    }
+    return n;
+}
+
 /* twx_run ******************************************************************/
 TWX_API twx_status_t ZLX_CALL twx_run
 (
@@ -293,110 +574,212 @@ TWX_API twx_status_t ZLX_CALL twx_run
     unsigned int cs;
 
     A(twx->state == TWX_INITED);
-    (void) twx;
+    ui_twx = twx;
 
     do
     {
-        O(acx1_write_start());
-        O(acx1_attr(0, 7, 0));
-        O(acx1_clear());
-        O(acx1_write_stop());
-        O(acx1_set_cursor_mode(0));
-        O(acx1_set_cursor_pos(1, 1));
+        O(out_begin(twx));
+        O(out_attr(twx, 0, 7, 0));
+        O(out_clear(twx));
+        if ((twx->caps & TWX_CAP_PASTE))
+        {
+            O(out_raw(twx, "\x1B[?2004h", 8));
+        }
+        O(out_cursor_mode(twx, 0));
+        O(out_cursor(twx, 1, 1));
+        O(out_end(twx));
         
-        hbs_mutex_lock(twx->main_mutex);
-        while (!twx->shutdown)
+        while (!ATOMIC_LOAD(&twx->shutdown))
         {
-            if (twx->screen_resized)
+            unsigned int kb, ke;
+            uint64_t now, wake_at, timer_at;
+
+            if (ATOMIC_LOAD(&twx->screen_resized))
             {
                 unsigned int h, w;
                 twx_win_t * root;
+                tcond_lock(twx->main);
                 twx->screen_resized = 0;
-                twx->draw_mode = TWX_DRAW;
                 root = twx->root_win;
+                h = twx->height;
+                w = twx->width;
+                tcond_unlock(twx->main);
+                ATOMIC_STORE(&twx->draw_mode, TWX_DRAW);
+                twx->draw_now = 1;
+                ts = fb_resize(twx, h, w);
+                if (ts) break;
                 if (root)
                 {
-                    h = twx->height;
-                    w = twx->width;
-                    hbs_mutex_unlock(twx->main_mutex);
                     L("calling geom for root=%p, h=%u, w=%u", root, h, w);
                     ts = twx_win_geom(root, 1, 1, h, w);
                     if (ts) break;
-                    hbs_mutex_lock(twx->main_mutex);
                 }
                 continue;
             }
-            if (twx->draw_mode)
+            if (ATOMIC_LOAD(&twx->draw_mode) && draw_due(twx, now = clock_us()))
             {
                 twx_win_t * root;
                 unsigned int mode;
-                mode = twx->draw_mode;
-                twx->draw_mode = 0;
-                root = twx->root_win;
+                mode = ATOMIC_XCHG(&twx->draw_mode, 0);
+                twx->frame_us = now;
+                twx->draw_now = 0;
+                root = ATOMIC_LOAD(&twx->root_win);
                 if (root)
                 {
-                    hbs_mutex_unlock(twx->main_mutex);
                     L("calling draw for root=%p with mode=%u", root, mode);
-                    O(acx1_write_start());
-                    ts = root->wcls->handler(root, mode, NULL);
+                    ts = win_event(root, mode, NULL);
+                    if (ts) break;
+                    O(out_begin(twx));
+                    ts = fb_flush(twx);
                     if (ts) break;
-                    O(acx1_write_stop());
-                    hbs_mutex_lock(twx->main_mutex);
+                    O(out_end(twx));
                 }
                 continue;
             }
-            if (twx->new_focus_win != twx->focus_win)
+            if (ATOMIC_LOAD(&twx->new_focus_win) != twx->focus_win)
             {
                 L("refocusing...");
-                ts = twx_win_focus(twx->new_focus_win);
+                ts = twx_win_focus(ATOMIC_LOAD(&twx->new_focus_win));
                 if (ts) { L("ouch %u", ts); break; }
-                A(twx->new_focus_win == twx->focus_win);
+                twx->draw_now = 1;
                 continue;
             }
 
-            if (twx->krb != twx->kre)
+            /* the key ring is consumed without locking: krb is only written
+             * by this thread and kre only by input_processor() */
+            kb = twx->krb;
+            ke = ATOMIC_LOAD(&twx->kre);
+            if (kb != ke)
             {
-                unsigned int km;
+                unsigned int n, used;
                 twx_win_t * win;
+#if TWX_TRACE
+                uint64_t t;
+#endif
                 win = twx->focus_win;
-                if (twx->key_ring[twx->krb] == (ACX1_ALT | '\\'))
+                if (twx->key_ring[kb] == TWX_KEY_PASTE)
+                {
+                    twx_paste_t * pst;
+                    tcond_lock(twx->main);
+                    pst = twx->paste_head;
+                    twx->paste_head = pst->next;
+                    if (!pst->next) twx->paste_tail = NULL;
+                    tcond_unlock(twx->main);
+                    ATOMIC_STORE(&twx->krb, (kb + 1) & twx->krm);
+                    TRACE(twx, TRACE_MAIN, TRACE_KEY_OUT, clock_ns(), 0,
+                          NULL, 0, twx->trace_key_out++);
+                    if (win)
+                    {
+                        L("sending paste of %lu bytes to win=%p",
+                          (unsigned long) pst->size, win);
+                        ei.paste.data = pst->data;
+                        ei.paste.size = pst->size;
+                        ts = win_event(win, TWX_PASTE, &ei);
+                        twx->draw_now = 1;
+                    }
+                    paste_free(pst);
+                    continue;
+                }
+                if (twx->key_ring[kb] == (ACX1_ALT | '\\'))
                 {
                     L("magic exit key");
-                    hbs_mutex_unlock(twx->main_mutex);
                     twx_shutdown(twx, TWX_OK);
                     break;
                 }
 
                 if (win)
                 {
-                    km = twx->key_ring[twx->krb++];
-                    twx->krb &= twx->krm;
-                    hbs_mutex_unlock(twx->main_mutex);
-                    L("sending key=0x%X to win=%p", km, win);
-                    ei.km = km;
-                    ts = win->wcls->handler(win, TWX_KEY, &ei);
-                    hbs_mutex_lock(twx->main_mutex);
+                    /* offer all contiguous pending keys up to the magic
+                     * exit key or the next paste in one go */
+                    if (ke < kb) ke = twx->krm + 1;
+                    for (n = 1; kb + n < ke; ++n)
+                        if (twx->key_ring[kb + n] == (ACX1_ALT | '\\')
+                            || twx->key_ring[kb + n] == TWX_KEY_PASTE) break;
+                    L("sending %u keys starting with 0x%X to win=%p",
+                      n, twx->key_ring[kb], win);
+                    ei.keys.km_a = twx->key_ring + kb;
+                    ei.keys.n = n;
+                    ei.keys.used = 0;
+#if TWX_TRACE
+                    t = clock_ns();
+#endif
+                    ts = win_event(win, TWX_KEYS, &ei);
+                    used = (unsigned int) ei.keys.used;
+                    if (!used)
+                    {
+                        used = 1;
+                        ei.km = twx->key_ring[kb];
+                        if (!ts) ts = win_event(win, TWX_KEY, &ei);
+                    }
+                    A(used <= n);
+                    ATOMIC_STORE(&twx->krb, (kb + used) & twx->krm);
+#if TWX_TRACE
+                    /* the flows end on the handler call after t */
+                    for (n = 0; n < used; ++n)
+                        trace_add(twx, TRACE_MAIN, TRACE_KEY_OUT, t, 0, NULL,
+                                  0, twx->trace_key_out++);
+#endif
+                    /* echo input without waiting for the frame interval */
+                    twx->draw_now = 1;
                 }
                 else
                 {
-                    L("no input win, consume all keys...");
-                    twx->krb = twx->kre = 0;
+                    L("no input win, consume keys up to the next paste...");
+                    for (; kb != ke && twx->key_ring[kb] != TWX_KEY_PASTE;
+                         kb = (kb + 1) & twx->krm)
+                        TRACE(twx, TRACE_MAIN, TRACE_KEY_OUT, clock_ns(), 0,
+                              NULL, 0, twx->trace_key_out++);
+                    ATOMIC_STORE(&twx->krb, kb);
                 }
                 continue;
             }
-            hbs_cond_wait(twx->main_cond, twx->main_mutex);
+
+            if (run_posted(twx, &ts))
+            {
+                if (ts) break;
+                continue;
+            }
+
+            if (timer_run(twx, &ts))
+            {
+                if (ts) break;
+                continue;
+            }
+
+            tcond_lock(twx->main);
+            ATOMIC_STORE(&twx->main_waiting, 1);
+            ATOMIC_FENCE();
+            if (!main_pending(twx))
+            {
+                /* sleep until the frame is due, if a draw is pending, or
+                 * until the next timer, whichever comes first */
+                wake_at = ATOMIC_LOAD(&twx->draw_mode)
+                    ? twx->frame_us + ATOMIC_LOAD(&twx->frame_interval) : 0;
+                timer_at = timer_next(twx);
+                if (timer_at && (!wake_at || timer_at < wake_at))
+                    wake_at = timer_at;
+                tcond_wait(twx->main, wake_at);
+                ++twx->stats.wakeups;
+            }
+            ATOMIC_STORE(&twx->main_waiting, 0);
+            tcond_unlock(twx->main);
         }
         twx->shutdown = 1;
 
-        O(acx1_write_start());
-        O(acx1_attr(0, 7, 0));
-        O(acx1_clear());
-        O(acx1_write_stop());
-        O(acx1_set_cursor_mode(1));
-        O(acx1_set_cursor_pos(1, 1));
+        O(out_begin(twx));
+        O(out_attr(twx, 0, 7, 0));
+        O(out_clear(twx));
+        if ((twx->caps & TWX_CAP_PASTE))
+        {
+            O(out_raw(twx, "\x1B[?2004l", 8));
+        }
+        O(out_cursor_mode(twx, 1));
+        O(out_cursor(twx, 1, 1));
+        O(out_end(twx));
     }
     while (0);
 
+    ui_twx = NULL;
     return ts;
 }
 
@@ -416,6 +799,106 @@ void * win_alloc (twx_t * twx, twx_win_class_t * wcls)
     return win;
 }
 
+/* class_stats **************************************************************/
+/**
+ *  Finds the stats of a window class, adding it if there is room.
+ *  @returns the stats or NULL if too many classes are in use
+ */
+static twx_class_stats_t * class_stats (twx_t * twx, twx_win_class_t * wcls)
+{
+    unsigned int i;
+
+    for (i = 0; i < twx->stats.class_n; ++i)
+        if (twx->stats_cls[i] == wcls) return &twx->stats.class_a[i];
+    if (i == TWX_STATS_CLASSES) return NULL;
+    twx->stats_cls[i] = wcls;
+    twx->stats.class_a[i].name = wcls->name;
+    twx->stats.class_n = i + 1;
+    return &twx->stats.class_a[i];
+}
+
+TWX_TLS twx_t * ui_twx;
+
+/* win_event ****************************************************************/
+twx_status_t win_event (twx_win_t * win, unsigned int evt,
+                        twx_event_info_t * ei)
+{
+    twx_t * twx = win->twx;
+    twx_class_stats_t * cls;
+    twx_status_t ts;
+    uint64_t t, t0, t1, outer;
+
+    /* windows called from other threads, as by twx_win_refresh(), would
+     * race with twx_run() on the counters and the nesting of the timing */
+    if (ui_twx != twx) return win->wcls->handler(win, evt, ei);
+
+    if (evt < TWX_EVENT_COUNT)
+    {
+        ++twx->stats.events[evt];
+        ++win->stats.events[evt];
+    }
+    if (evt == TWX_DRAW)
+    {
+        if ((win->flags & TWX_WF_UPDATE))
+        {
+            ++twx->stats.draws;
+            ++win->stats.draws;
+        }
+        else
+        {
+            ++twx->stats.draws_skipped;
+            ++win->stats.draws_skipped;
+        }
+    }
+
+    outer = twx->nested_ns;
+    twx->nested_ns = 0;
+    t0 = clock_ns();
+    ts = win->wcls->handler(win, evt, ei);
+    t1 = clock_ns();
+    TRACE(twx, TRACE_MAIN, TRACE_HANDLER, t0, t1, win->wcls->name, evt, 0);
+    t = t1 - t0;
+    /* charge the window only for its own time and the caller for all */
+    win->stats.handler_ns += t - twx->nested_ns;
+    cls = class_stats(twx, win->wcls);
+    if (cls)
+    {
+        ++cls->events;
+        cls->handler_ns += t - twx->nested_ns;
+    }
+    twx->nested_ns = outer + t;
+    return ts;
+}
+
+/* twx_win_draw *************************************************************/
+TWX_API twx_status_t ZLX_CALL twx_win_draw
+(
+    twx_win_t * win
+)
+{
+    return win_event(win, TWX_DRAW, NULL);
+}
+
+/* twx_stats ****************************************************************/
+TWX_API void ZLX_CALL twx_stats
+(
+    twx_t * twx,
+    twx_stats_t * stats
+)
+{
+    *stats = twx->stats;
+}
+
+/* twx_win_stats ************************************************************/
+TWX_API void ZLX_CALL twx_win_stats
+(
+    twx_win_t * win,
+    twx_win_stats_t * stats
+)
+{
+    *stats = win->stats;
+}
+
 /* twx_nop_draw *************************************************************/
 TWX_API twx_status_t ZLX_CALL twx_nop_draw (twx_win_t * win, unsigned int mode)
 {
@@ -459,10 +942,47 @@ TWX_API twx_status_t ZLX_CALL twx_win_write_geom
     win->scr_col = scr_col;
     win->height = height;
     win->width = width;
-    win->flags |= TWX_WF_UPDATE;
+    win->dmg_height = 0;
+    twx_win_damage(win, scr_row, scr_col, height, width);
     return TWX_OK;
 }
 
+/* twx_win_damage ***********************************************************/
+TWX_API void ZLX_CALL twx_win_damage
+(
+    twx_win_t * win,
+    unsigned int scr_row,
+    unsigned int scr_col,
+    unsigned int height,
+    unsigned int width
+)
+{
+    unsigned int r0, c0, r1, c1;
+
+    r0 = scr_row > win->scr_row ? scr_row : win->scr_row;
+    c0 = scr_col > win->scr_col ? scr_col : win->scr_col;
+    r1 = scr_row + height < win->scr_row + win->height
+        ? scr_row + height : win->scr_row + win->height;
+    c1 = scr_col + width < win->scr_col + win->width
+        ? scr_col + width : win->scr_col + win->width;
+    if (r0 >= r1 || c0 >= c1) return;
+
+    if (win->dmg_height && win->dmg_width)
+    {
+        if (r0 > win->dmg_row) r0 = win->dmg_row;
+        if (c0 > win->dmg_col) c0 = win->dmg_col;
+        if (r1 < win->dmg_row + win->dmg_height)
+            r1 = win->dmg_row + win->dmg_height;
+        if (c1 < win->dmg_col + win->dmg_width)
+            c1 = win->dmg_col + win->dmg_width;
+    }
+    win->dmg_row = r0;
+    win->dmg_col = c0;
+    win->dmg_height = r1 - r0;
+    win->dmg_width = c1 - c0;
+    win->flags |= TWX_WF_UPDATE;
+}
+
 /* twx_win_geom *************************************************************/
 TWX_API twx_status_t ZLX_CALL twx_win_geom
 (
@@ -483,9 +1003,9 @@ TWX_API twx_status_t ZLX_CALL twx_win_geom
     ei.geom.width = width;
     do
     {
-        ts = win->wcls->handler(win, TWX_GEOM, &ei);
+        ts = win_event(win, TWX_GEOM, &ei);
         if (ts) break;
-        ts = win->wcls->handler(win, TWX_INVALIDATE, &ei);
+        ts = win_event(win, TWX_INVALIDATE, &ei);
         if (ts) break;
         twx_refresh(win->twx);
     }
@@ -514,7 +1034,7 @@ TWX_API twx_status_t ZLX_CALL twx_win_invalidate
     ei.geom.width = width;
     do
     {
-        ts = win->wcls->handler(win, TWX_INVALIDATE, &ei);
+        ts = win_event(win, TWX_INVALIDATE, &ei);
         if (ts) break;
         twx_refresh(win->twx);
     }
@@ -523,6 +1043,25 @@ TWX_API twx_status_t ZLX_CALL twx_win_invalidate
     return ts;
 }
 
+/* post_drop_win ************************************************************/
+/**
+ *  Drops the events posted to a window and not delivered yet, which
+ *  run_posted() then skips.
+ */
+static void post_drop_win (twx_win_t * win)
+{
+    twx_t * twx = win->twx;
+    twx_post_t * p;
+    size_t b, e;
+
+    e = ATOMIC_LOAD(&twx->pre);
+    for (b = twx->prb; b != e; ++b)
+    {
+        p = &twx->post_ring[b & twx->prm];
+        if (ATOMIC_LOAD(&p->seq) == b + 1 && p->win == win) p->win = NULL;
+    }
+}
+
 /* twx_win_destroy **********************************************************/
 TWX_API void ZLX_CALL twx_win_destroy
 (
@@ -530,6 +1069,8 @@ TWX_API void ZLX_CALL twx_win_destroy
 )
 {
     twx_win_class_t * wcls = win->wcls;
+    timer_stop_win(win);
+    post_drop_win(win);
     HBS_DM("calling $s@$p.finish()...", wcls->name, win);
     wcls->finish(win);
     HBS_DM("freeing $s@$p...", wcls->name, win);
@@ -552,14 +1093,18 @@ TWX_API twx_status_t ZLX_CALL twx_default_handler
         win->scr_col = ei->geom.scr_col;
         win->height = ei->geom.height;
         win->width = ei->geom.width;
+        win->dmg_height = 0;
         HBS_DM("storing new geometry $i+$i+$ix$i for $s@$i",
                win->scr_col, win->scr_row, win->width, win->height,
                win->wcls->name, win->id);
         break;
 
     case TWX_INVALIDATE:
-        win->flags |= TWX_WF_UPDATE;
-        HBS_DM("setting flag update for $s@$i", win->wcls->name, win->id);
+        twx_win_damage(win, ei->geom.scr_row, ei->geom.scr_col,
+                       ei->geom.height, ei->geom.width);
+        HBS_DM("damaged $i+$i+$ix$i for $s@$i",
+               win->dmg_col, win->dmg_row, win->dmg_width, win->dmg_height,
+               win->wcls->name, win->id);
         break;
     }
     return TWX_OK;
@@ -18,10 +18,21 @@
 // when there is text that doesn't fit on the display
 #define TWX_ITXT_ATTR_COUNT 3
 
+#define TWX_SPLIT_ROWS 0 // children stacked top to bottom
+#define TWX_SPLIT_COLS 1 // children placed left to right
+
 typedef enum twx_status_enum twx_status_t;
 typedef struct twx_s twx_t;
 typedef struct twx_win_class_s twx_win_class_t;
 typedef struct twx_win_s twx_win_t;
+typedef struct twx_backend_class_s twx_backend_class_t;
+typedef struct twx_backend_s twx_backend_t;
+typedef struct twx_headless_stats_s twx_headless_stats_t;
+typedef struct twx_stats_s twx_stats_t;
+typedef struct twx_win_stats_s twx_win_stats_t;
+typedef struct twx_class_stats_s twx_class_stats_t;
+typedef void (ZLX_CALL * twx_htxt_release_f) (void * ctx, void const * data,
+                                              size_t size);
 
 enum twx_event_enum
 {
@@ -34,6 +45,55 @@ enum twx_event_enum
     TWX_KEY,
     TWX_ITXT_ENTERED,
     TWX_ITXT_CANCELLED,
+    TWX_KEYS, // batch of pending keys; see twx_event_info_t.keys
+    TWX_FVIEW_PROGRESS, // more of the file was indexed; see .progress
+    TWX_PASTE, // bracketed paste, if acx1 reports its markers; see .paste
+    TWX_TIMER, // timer started with twx_timer_start() expired; see .id
+    TWX_EVENT_COUNT // number of event types above
+};
+
+#define TWX_STATS_CLASSES 16 // window classes tracked by twx_stats()
+
+/* twx_win_stats_s **********************************************************/
+/**
+ *  Counters of a window; see twx_win_stats().
+ *  Handler times exclude the time spent in handlers of other windows
+ *  called from it, as when a container draws its children.
+ */
+struct twx_win_stats_s
+{
+    uint64_t events[TWX_EVENT_COUNT]; // handler calls by event type
+    uint64_t draws; // TWX_DRAW calls with TWX_WF_UPDATE set
+    uint64_t draws_skipped; // TWX_DRAW calls with nothing to update
+    uint64_t handler_ns; // time spent in the handler
+};
+
+/* twx_class_stats_s ********************************************************/
+/**
+ *  Counters of all windows of a class in an instance.
+ */
+struct twx_class_stats_s
+{
+    char const * name; // name of the window class
+    uint64_t events; // handler calls
+    uint64_t handler_ns; // time spent in handlers of the class
+};
+
+/* twx_stats_s **************************************************************/
+/**
+ *  Counters of an instance; see twx_stats().
+ */
+struct twx_stats_s
+{
+    uint64_t events[TWX_EVENT_COUNT]; // handler calls by event type
+    uint64_t draws; // TWX_DRAW calls with TWX_WF_UPDATE set
+    uint64_t draws_skipped; // TWX_DRAW calls with nothing to update
+    uint64_t frames; // frames sent to the terminal
+    uint64_t out_bytes; // bytes sent to the terminal
+    uint64_t keys_dropped; // keys and pastes lost to a full key ring on exit
+    uint64_t wakeups; // returns of twx_run() from its wait
+    unsigned int class_n; // entries used in class_a, in order of first use
+    twx_class_stats_t class_a[TWX_STATS_CLASSES];
 };
 
 typedef union twx_event_info_u twx_event_info_t;
@@ -47,7 +107,26 @@ union twx_event_info_u
         unsigned int width;
     } geom;
     uint32_t km;
+    struct
+    {
+        uint32_t const * km_a; // pending keys, in the order they were typed
+        size_t n; // number of keys in km_a
+        size_t used; // set by the handler to the number of keys it consumed
+        // from the start of km_a; if left 0 the first key is delivered
+        // with TWX_KEY and the rest are offered again in a new TWX_KEYS
+    } keys;
     unsigned int id;
+    struct
+    {
+        unsigned int id; // ntf_id given at creation (same as .id)
+        uint64_t done; // bytes of the file indexed so far
+        uint64_t total; // size of the file
+    } progress;
+    struct
+    {
+        uint8_t const * data; // UTF-8 text; only valid during the event
+        size_t size; // number of bytes in data
+    } paste;
 };
 
 struct twx_win_class_s
@@ -59,15 +138,83 @@ struct twx_win_class_s
     char const * name;
 };
 
+/* twx_backend_class_s *****************************************************/
+/**
+ *  Operations of a terminal the interface draws to and reads input from.
+ *  They mirror the acx1 functions of the same name, including the 1-based
+ *  row and column arguments and returning 0 on success; output between
+ *  write_start() and write_stop() makes up one frame.
+ *  read_event() is called from the input thread and blocks until an event
+ *  is available; once finish() is called it must return ACX1_FINISH.
+ */
+struct twx_backend_class_s
+{
+    unsigned int (ZLX_CALL * init) (twx_backend_t * be);
+    void (ZLX_CALL * finish) (twx_backend_t * be);
+    unsigned int (ZLX_CALL * read_event) (twx_backend_t * be,
+                                          acx1_event_t * e);
+    unsigned int (ZLX_CALL * get_screen_size) (twx_backend_t * be,
+                                               uint16_t * h, uint16_t * w);
+    unsigned int (ZLX_CALL * write_start) (twx_backend_t * be);
+    unsigned int (ZLX_CALL * write_stop) (twx_backend_t * be);
+    unsigned int (ZLX_CALL * attr) (twx_backend_t * be, unsigned int bg,
+                                    unsigned int fg, unsigned int mode);
+    unsigned int (ZLX_CALL * clear) (twx_backend_t * be);
+    unsigned int (ZLX_CALL * set_cursor_mode) (twx_backend_t * be,
+                                               unsigned int mode);
+    unsigned int (ZLX_CALL * set_cursor_pos) (twx_backend_t * be,
+                                              unsigned int row,
+                                              unsigned int col);
+    unsigned int (ZLX_CALL * write_pos) (twx_backend_t * be,
+                                         unsigned int row, unsigned int col);
+    unsigned int (ZLX_CALL * write) (twx_backend_t * be, void const * data,
+                                     size_t size);
+    char const * name;
+};
+
+/* terminal capabilities */
+#define TWX_CAP_SCROLL_REGION (1 << 0) // DECSTBM + SU/SD
+#define TWX_CAP_PASTE (1 << 1) // bracketed paste (DECSET 2004)
+#define TWX_CAP_VT (1 << 2) // output is VT: relative moves, CR/LF, ECH, EL,
+// SGR with mode bits 0 - 3 as bold, underline, blink and reverse
+#define TWX_CAP_REP (1 << 3) // repeats the last char (REP)
+#define TWX_CAP_SYNC (1 << 4) // synchronized output (DECSET 2026)
+
+struct twx_backend_s
+{
+    twx_backend_class_t * bcls;
+    unsigned int caps; // TWX_CAP_xxx
+};
+
+/* twx_headless_stats_s *****************************************************/
+/**
+ *  Output counted by a headless backend.
+ */
+struct twx_headless_stats_s
+{
+    uint64_t frames; // write_start() / write_stop() pairs
+    uint64_t bytes; // bytes a VT terminal would have received
+    uint64_t escapes; // escape sequences among those bytes
+    uint64_t cursor_moves; // escape sequences moving the cursor
+    uint64_t writes; // backend calls carrying output
+};
+
 #define TWX_WF_UPDATE   (1 << 0)
+#define TWX_WF_CONTAINER (1 << 1) // has child windows that may need drawing
+// even when the container itself has nothing to update
 
 struct twx_win_s
 {
     twx_win_class_t * wcls;
     twx_t * twx;
     unsigned int scr_row, scr_col, height, width;
+    unsigned int dmg_row, dmg_col, dmg_height, dmg_width; // damaged region
+    // in screen coordinates accumulated by TWX_INVALIDATE since last draw;
+    // empty if dmg_height is 0
     unsigned int flags;
     unsigned int id;
+    twx_win_stats_t stats;
+    struct twx_timer_s * timers; // started with twx_timer_start()
 };
 
 enum twx_status_enum
@@ -80,6 +227,10 @@ enum twx_status_enum
     TWX_CONSOLE_INIT_ERROR,
     TWX_CONSOLE_INPUT_ERROR,
     TWX_CONSOLE_OUTPUT_ERROR,
+    TWX_FILE_ERROR,
+    TWX_QUEUE_FULL,
+    TWX_BAD_SIZE,
+    TWX_NO_TRACE, // the library was built without the trace ring
     TWX_BUG,
 };
 
@@ -100,6 +251,17 @@ TWX_API twx_status_t ZLX_CALL twx_create
     twx_t * * twx_ptr
 );
 
+/* twx_create_on ************************************************************/
+/**
+ *  Creates an instance drawing to the given backend instead of the acx1
+ *  console. The backend must outlive the instance.
+ */
+TWX_API twx_status_t ZLX_CALL twx_create_on
+(
+    twx_t * * twx_ptr,
+    twx_backend_t * be
+);
+
 /* twx_destroy **************************************************************/
 /**
  *  Destroys the instance.
@@ -139,21 +301,105 @@ TWX_API void ZLX_CALL twx_refresh
     twx_t * twx
 );
 
+/* twx_set_frame_interval ***************************************************/
+/**
+ *  Sets the minimum time between 2 consecutive screen draws.
+ *  Refresh requests made in between are collapsed into a single draw done
+ *  once the interval elapses; draws caused by input, resize or focus
+ *  changes are done right away.
+ *  The default is 1/60 seconds; 0 disables the limit.
+ */
+TWX_API void ZLX_CALL twx_set_frame_interval
+(
+    twx_t * twx,
+    unsigned int usec
+);
+
+/* twx_timer_start **********************************************************/
+/**
+ *  Starts a timer sending TWX_TIMER with the given id to the window every
+ *  usec microseconds, with a millisecond resolution. Starting a timer
+ *  the window already has with that id restarts it with the new interval.
+ *  Timers are kept on a timer wheel by the thread running twx_run(), so
+ *  this must be called from a handler or before twx_run() starts; other
+ *  threads can post an event to a window that starts the timer.
+ *  Timers of a window are stopped when the window is destroyed.
+ *  While idle, twx_run() sleeps until the next timer is due, so a timer
+ *  costs one wakeup per expiry and no thread of its own.
+ */
+TWX_API twx_status_t ZLX_CALL twx_timer_start
+(
+    twx_win_t * win,
+    unsigned int usec,
+    unsigned int id
+);
+
+/* twx_timer_stop ***********************************************************/
+/**
+ *  Stops the timer of the window with the given id, if running.
+ *  Same thread rules as twx_timer_start().
+ */
+TWX_API void ZLX_CALL twx_timer_stop
+(
+    twx_win_t * win,
+    unsigned int id
+);
+
+/* twx_stats ****************************************************************/
+/**
+ *  Copies the counters of the instance.
+ *  The counters are always kept; they are read without stopping twx_run()
+ *  so a copy taken from another thread may be slightly behind.
+ *  Only handler calls made on the thread running twx_run() are counted and
+ *  timed; those made from other threads, as by twx_win_refresh() on a
+ *  hypertext window, are not.
+ */
+TWX_API void ZLX_CALL twx_stats
+(
+    twx_t * twx,
+    twx_stats_t * stats
+);
+
+/* twx_win_stats ************************************************************/
+/**
+ *  Copies the counters of a window; they are kept as for twx_stats().
+ */
+TWX_API void ZLX_CALL twx_win_stats
+(
+    twx_win_t * win,
+    twx_win_stats_t * stats
+);
+
+/* twx_trace_dump ***********************************************************/
+/**
+ *  Writes the records of the trace rings to a file in the Chrome trace
+ *  event format, which chrome://tracing and Perfetto load.
+ *  The rings keep the latest handler calls, frames, input reads and keys of
+ *  the UI and input threads; each queued key is linked to the handler call
+ *  that takes it. Can be called from any thread while twx_run() goes on.
+ *  @retval TWX_NO_TRACE the library was built without tracing
+ */
+TWX_API twx_status_t ZLX_CALL twx_trace_dump
+(
+    twx_t * twx,
+    char const * path
+);
+
 /* twx_win_draw *************************************************************/
 /**
  *  Call the window class to do the actual drawing.
  */
-ZLX_INLINE twx_status_t ZLX_CALL twx_win_draw
+TWX_API twx_status_t ZLX_CALL twx_win_draw
 (
     twx_win_t * win
-)
-{
-    return win->wcls->handler(win, TWX_DRAW, NULL);
-}
+);
 
 /* twx_win_destroy **********************************************************/
 /**
  *  Destroys window.
+ *  Its timers are stopped and the events posted to it and not delivered
+ *  yet are dropped. Must be called from a handler or while twx_run() is
+ *  not running.
  */
 TWX_API void ZLX_CALL twx_win_destroy
 (
@@ -191,6 +437,26 @@ TWX_API void ZLX_CALL twx_post_win_focus
     twx_win_t * win
 );
 
+/* twx_post_event ***********************************************************/
+/**
+ *  Queues an event for the given window; twx_run() calls the window's
+ *  handler with it on the ui thread.
+ *  Safe to call from any number of threads at once; it neither locks nor
+ *  allocates. The event info is copied, but anything it points to must
+ *  stay valid until the handler runs. Events still pending when the window
+ *  is destroyed are dropped; the window must not be destroyed while this
+ *  call is in progress for it.
+ *  @param ei event info; NULL to pass zeroes
+ *  @retval TWX_OK event queued
+ *  @retval TWX_QUEUE_FULL too many events pending; nothing was queued
+ */
+TWX_API twx_status_t ZLX_CALL twx_post_event
+(
+    twx_win_t * win,
+    unsigned int evt,
+    twx_event_info_t const * ei
+);
+
 /* twx_set_geom *************************************************************/
 /**
  *  Requests the window to update itself to specified geometry.
@@ -207,7 +473,12 @@ TWX_API twx_status_t ZLX_CALL twx_win_geom
 /* twx_win_invalidate *******************************************************/
 /**
  *  Requests the window to invalidate the given region so that a subsequent
- *  delivery of TWX_DRAW will cause that region to be refreshed
+ *  delivery of TWX_DRAW will cause that region to be refreshed.
+ *  Must be called from a handler or before twx_run() starts: the damaged
+ *  region is read and cleared by the draw without a lock. Other threads
+ *  post an event to the window with twx_post_event() and invalidate from
+ *  its handler; hypertext windows are the exception, as they guard their
+ *  damage with the lock they draw under.
  */
 TWX_API twx_status_t ZLX_CALL twx_win_invalidate
 (
@@ -219,6 +490,9 @@ TWX_API twx_status_t ZLX_CALL twx_win_invalidate
 );
 
 /* twx_win_refresh **********************************************************/
+/**
+ *  Invalidates the whole window; same thread rules as twx_win_invalidate().
+ */
 ZLX_INLINE twx_status_t twx_win_refresh
 (
     twx_win_t * win
@@ -228,6 +502,24 @@ ZLX_INLINE twx_status_t twx_win_refresh
                               win->height, win->width);
 }
 
+/* twx_win_damage ***********************************************************/
+/**
+ *  Adds the given region (in screen coordinates) to the damaged region of
+ *  the window and sets TWX_WF_UPDATE.
+ *  The region is clipped to the window and coalesced with the existing
+ *  damage into their bounding rectangle.
+ *  This function is suitable for a window class TWX_INVALIDATE callback.
+ *  Same thread rules as twx_win_invalidate().
+ */
+TWX_API void ZLX_CALL twx_win_damage
+(
+    twx_win_t * win,
+    unsigned int scr_row,
+    unsigned int scr_col,
+    unsigned int height,
+    unsigned int width
+);
+
 /* twx_win_write_geom *******************************************************/
 /**
  *  Updates the geometry fields from the given window.
@@ -260,6 +552,51 @@ TWX_API twx_status_t ZLX_CALL twx_blank_win_create
     uint32_t ch
 );
 
+/* twx_split_win_create *****************************************************/
+/**
+ *  Creates a container window that tiles its children along one axis.
+ *  dir is TWX_SPLIT_ROWS or TWX_SPLIT_COLS.
+ *  The layout is recomputed only when the geometry of the container or its
+ *  set of children changes, and only the children with pending updates
+ *  are asked to draw.
+ *  Children are not destroyed together with the container.
+ */
+TWX_API twx_status_t ZLX_CALL twx_split_win_create
+(
+    twx_t * twx,
+    twx_win_t * * win_ptr,
+    acx1_attr_t * attr,
+    unsigned int dir
+);
+
+/* twx_split_win_add ********************************************************/
+/**
+ *  Appends a child to the container.
+ *  The child gets size cells along the split axis plus a share of the space
+ *  left after all children got their size, proportional to weight.
+ *  The set of children is read by twx_run() without locking, so this must
+ *  be called from a handler or before twx_run() starts; other threads can
+ *  post an event to a window that adds the child.
+ */
+TWX_API twx_status_t ZLX_CALL twx_split_win_add
+(
+    twx_win_t * win,
+    twx_win_t * child,
+    unsigned int size,
+    unsigned int weight
+);
+
+/* twx_split_win_remove *****************************************************/
+/**
+ *  Removes a child from the container.
+ *  Same thread rules as twx_split_win_add().
+ */
+TWX_API twx_status_t ZLX_CALL twx_split_win_remove
+(
+    twx_win_t * win,
+    twx_win_t * child
+);
+
 /* twx_htxt_win_create ******************************************************/
 /**
  * Creates a hypertext window.
@@ -276,6 +613,9 @@ TWX_API twx_status_t ZLX_CALL twx_htxt_win_create
 /* twx_htxt_win_set_content *************************************************/
 /**
  *  Sets the content of the hypertext window.
+ *  This and the other twx_htxt_win_xxx() functions, as well as
+ *  twx_win_invalidate() on a hypertext window, can be called from any
+ *  thread.
  *  The format of the text is UTF8 with no control chars other than '\n'
  *  (signifying new line) and '\a' which is followed by a single byte
  *  signifying the index of the attribute to be selected for displaying the
@@ -289,6 +629,80 @@ TWX_API twx_status_t ZLX_CALL twx_htxt_win_set_content
     void const * htxt
 );
 
+/* twx_htxt_win_set_content_ref *********************************************/
+/**
+ *  Sets the content of the hypertext window to the given buffer without
+ *  copying it; the window only keeps the position of each line.
+ *  The format is the same as for twx_htxt_win_set_content() except that
+ *  the text is delimited by size instead of a NUL byte.
+ *  The buffer must stay valid and unchanged until release (if not NULL) is
+ *  called, which happens when the content is replaced or the window is
+ *  destroyed. This allows showing memory-mapped files.
+ *  If the call fails the window is left empty and release is called
+ *  when the content is next replaced.
+ */
+TWX_API twx_status_t ZLX_CALL twx_htxt_win_set_content_ref
+(
+    twx_win_t * win,
+    void const * htxt,
+    size_t size,
+    twx_htxt_release_f release,
+    void * ctx
+);
+
+/* twx_htxt_win_append ******************************************************/
+/**
+ *  Adds rows at the end of the content of the hypertext window, one for
+ *  each line in the given text (same format as for
+ *  twx_htxt_win_set_content(); a single trailing '\n' is ignored).
+ *  If the window shows the last row it scrolls to keep showing it.
+ *  Only the new rows are rendered; the rows already present are not
+ *  parsed again.
+ */
+TWX_API twx_status_t ZLX_CALL twx_htxt_win_append
+(
+    twx_win_t * win,
+    void const * htxt
+);
+
+/* twx_htxt_win_set_max_rows ************************************************/
+/**
+ *  Limits the number of rows kept by the hypertext window; when the limit
+ *  is reached the oldest rows are dropped to make room for the new ones.
+ *  0 means no limit (the default).
+ */
+TWX_API twx_status_t ZLX_CALL twx_htxt_win_set_max_rows
+(
+    twx_win_t * win,
+    size_t max_rows
+);
+
+/* twx_htxt_win_set_top *****************************************************/
+/**
+ *  Sets the index of the content row displayed at the top of the window.
+ *  The value is limited so that the window does not scroll past the end of
+ *  the content.
+ *  Only the rows that come into view are rendered; on terminals that
+ *  support scroll regions the rows still in view are moved by the terminal
+ *  itself instead of being sent again.
+ */
+TWX_API twx_status_t ZLX_CALL twx_htxt_win_set_top
+(
+    twx_win_t * win,
+    size_t top
+);
+
+/* twx_htxt_win_scroll ******************************************************/
+/**
+ *  Scrolls the content of the window by the given number of rows
+ *  (down the content if delta > 0).
+ */
+TWX_API twx_status_t ZLX_CALL twx_htxt_win_scroll
+(
+    twx_win_t * win,
+    ptrdiff_t delta
+);
+
 /* twx_itxt_win_create ******************************************************/
 /**
  *  Creates an input text window.
@@ -305,5 +719,105 @@ TWX_API twx_status_t ZLX_CALL twx_itxt_win_create
     unsigned int ntf_id
 );
 
-#endif
+/* twx_fview_win_create *****************************************************/
+/**
+ *  Creates a window showing a (possibly very large) text file.
+ *  The file is memory-mapped and shown as hypertext without being copied.
+ *  The first screen is indexed before returning; the rest of the file is
+ *  indexed by a background thread and its rows become visible as they are
+ *  found, so the window can be scrolled with twx_htxt_win_set_top() and
+ *  twx_htxt_win_scroll() while indexing is in progress.
+ *  If ntf_win is not NULL it receives TWX_FVIEW_PROGRESS events with
+ *  ntf_id as indexing advances; the last one has done == total.
+ *  They are posted as with twx_post_event(), so ntf_win must stay valid
+ *  while any is pending. When the queue is full, a progress event is
+ *  skipped, except the last one, which the indexing thread retries.
+ *  twx_htxt_win_set_content*() and twx_htxt_win_append() must not be used
+ *  on this window.
+ */
+TWX_API twx_status_t ZLX_CALL twx_fview_win_create
+(
+    twx_t * twx,
+    twx_win_t * * win_ptr,
+    acx1_attr_t * attr_a,
+    size_t attr_n,
+    char const * path,
+    twx_win_t * ntf_win,
+    unsigned int ntf_id
+);
+
+/* twx_headless_create ******************************************************/
+/**
+ *  Creates a backend emulating a VT terminal of the given size in memory.
+ *  Everything drawn is encoded as escape sequences, counted and applied to
+ *  a screen model that can be inspected with twx_headless_row(); input
+ *  comes only from twx_headless_push().
+ */
+TWX_API twx_status_t ZLX_CALL twx_headless_create
+(
+    twx_backend_t * * be_ptr,
+    unsigned int height,
+    unsigned int width
+);
 
+/* twx_headless_destroy *****************************************************/
+/**
+ *  Frees a headless backend; the instance using it must be destroyed first.
+ */
+TWX_API void ZLX_CALL twx_headless_destroy
+(
+    twx_backend_t * be
+);
+
+/* twx_headless_push ********************************************************/
+/**
+ *  Queues an input event as if the terminal had sent it.
+ *  An ACX1_RESIZE event also resizes the screen model.
+ *  Returns TWX_QUEUE_FULL if too many events are waiting.
+ */
+TWX_API twx_status_t ZLX_CALL twx_headless_push
+(
+    twx_backend_t * be,
+    acx1_event_t const * e
+);
+
+/* twx_headless_stats *******************************************************/
+/**
+ *  Gets the output counters since creation and those of the last frame.
+ *  Either pointer can be NULL.
+ */
+TWX_API void ZLX_CALL twx_headless_stats
+(
+    twx_backend_t * be,
+    twx_headless_stats_t * total,
+    twx_headless_stats_t * last
+);
+
+/* twx_headless_wait ********************************************************/
+/**
+ *  Blocks until the backend has received the given number of frames in
+ *  total, the instance using it is destroyed, or usec microseconds pass.
+ *  Returns the number of frames received, which is less than frames if
+ *  the wait ended early; only one thread may wait.
+ */
+TWX_API uint64_t ZLX_CALL twx_headless_wait
+(
+    twx_backend_t * be,
+    uint64_t frames,
+    unsigned int usec
+);
+
+/* twx_headless_row *********************************************************/
+/**
+ *  Copies the text of a screen row (0-based) as UTF-8, truncated to fit
+ *  and NUL-terminated; returns the length of the full row text.
+ */
+TWX_API size_t ZLX_CALL twx_headless_row
+(
+    twx_backend_t * be,
+    unsigned int row,
+    char * buf,
+    size_t size
+);
+
+#endif
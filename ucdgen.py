@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# Generates ucd.c: the display width and word class of every code point,
+# as a two-level table built from the Unicode data bundled with Python.
+# Run with: make ucd
+
+import sys
+import unicodedata
+
+BLOCK = 256
+
+def width(cp):
+    c = chr(cp)
+    cat = unicodedata.category(c)
+    if cat in ('Cc', 'Cs'): return -1
+    if cp == 0xAD: return 1 # soft hyphen is shown
+    if cat in ('Mn', 'Me', 'Cf'): return 0
+    if 0x1160 <= cp <= 0x11FF: return 0 # conjoining jamo
+    if unicodedata.east_asian_width(c) in ('W', 'F'): return 2
+    return 1
+
+def cls(cp):
+    cat = unicodedata.category(chr(cp))
+    if cat == 'Zs': return 0
+    if cat == 'Cc': return 1
+    if cat[0] in 'LNM' or cat == 'Pc': return 2
+    return 3
+
+def entry(cp):
+    return (width(cp) + 1) | (cls(cp) << 2)
+
+def main():
+    blocks = []
+    index = {}
+    stage1 = []
+    for b in range(0x110000 // BLOCK):
+        blk = tuple(entry(cp) for cp in range(b * BLOCK, (b + 1) * BLOCK))
+        if blk not in index:
+            index[blk] = len(blocks)
+            blocks.append(blk)
+        stage1.append(index[blk])
+    assert len(blocks) <= 0x100
+
+    o = sys.stdout
+    o.write('/* generated by ucdgen.py from Unicode %s - do not edit */\n'
+            % unicodedata.unidata_version)
+    o.write('#include "intern.h"\n\n')
+    o.write('uint8_t const ucd_stage1[0x%X] =\n{\n' % len(stage1))
+    for i in range(0, len(stage1), 16):
+        o.write('    ' + ', '.join('%d' % x for x in stage1[i:i + 16])
+                + ',\n')
+    o.write('};\n\n')
+    o.write('uint8_t const ucd_stage2[0x%X][0x%X] =\n{\n'
+            % (len(blocks), BLOCK))
+    for blk in blocks:
+        o.write('    {\n')
+        for i in range(0, BLOCK, 16):
+            o.write('        ' + ', '.join('%d' % x for x in blk[i:i + 16])
+                    + ',\n')
+        o.write('    },\n')
+    o.write('};\n')
+
+main()